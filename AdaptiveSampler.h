@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "log.h"
+#include "util.h"
 
 template <class T> class AdaptiveSampler {
 public:
@@ -37,7 +38,7 @@ public:
   void sample(T s) {
     total_samples++;
 
-    if (drand48() < (1/(double) sample_rate))
+    if (rng_double() < (1/(double) sample_rate))
       samples.push_back(s);
 
     // Throw out half of the samples, double sample_rate.
@@ -46,7 +47,7 @@ public:
 
       std::vector<T> half_samples;
       for (unsigned int i = 0; i < samples.size(); i++) {
-        if (drand48() > .5) half_samples.push_back(samples[i]);
+        if (rng_double() > .5) half_samples.push_back(samples[i]);
       }
       samples = half_samples;
     }
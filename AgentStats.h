@@ -3,15 +3,37 @@
 #define AGENTSTATS_H
 
 #include "LogHistogramSampler.h"
+#include "Operation.h"
+#include "Popularity.h"
+#include "SizeBuckets.h"
 
 class AgentStats {
 public:
   uint64_t rx_bytes, tx_bytes;
-  uint64_t gets, sets, get_misses;
+  uint64_t gets, sets, get_misses, single_misses;
+  uint64_t others, type_ops[OP_TYPES], type_misses[OP_TYPES];  // --ops
+  uint64_t rmw_attempts, rmw_conflicts, rmw_aborts;
+  uint64_t rmw_retries[RMW_RETRY_BINS];
   uint64_t skips;
+  uint64_t fanouts, fanout_parts;
   uint64_t get_bins[LOGSAMPLER_BINS];
   double get_sum;
   double get_sum_sq;
+  uint64_t phase_bins[POP_PHASES][LOGSAMPLER_BINS];  // --flash_crowd
+  double phase_sum[POP_PHASES], phase_sum_sq[POP_PHASES];
+  uint64_t shard_bins[LOGSAMPLER_BINS], fanout_bins[LOGSAMPLER_BINS];
+  double shard_sum, shard_sum_sq, fanout_sum, fanout_sum_sq;  // --fanout
+  uint64_t size_bins[SIZE_BUCKETS][LOGSAMPLER_BINS];  // --size_buckets
+  double size_sum[SIZE_BUCKETS], size_sum_sq[SIZE_BUCKETS];
+  uint64_t size_ops[SIZE_BUCKETS], size_bytes[SIZE_BUCKETS];
+  uint64_t type_bins[OP_TYPES][LOGSAMPLER_BINS];
+  double type_sum[OP_TYPES], type_sum_sq[OP_TYPES];
+
+  double slo_qps, slo_qps_ci;
+  int slo_intervals;
+
+  uint64_t loads, load_bytes, load_errors;
+  double load_time;
 
   double start, stop;
 };
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <netinet/tcp.h>
 
 #include <event2/buffer.h>
@@ -11,6 +12,8 @@
 
 #include "Connection.h"
 #include "ConnectionStats.h"
+#include "Dataset.h"
+#include "Recorder.h"
 #include "distributions.h"
 #include "Generator.h"
 #include "KeyGenerator.h"
@@ -18,34 +21,55 @@
 #include "binary_protocol.h"
 #include "util.h"
 
-#define MAX_KEY_LEN 48
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
 #define MAX_MGET_KEYS 512
+#define MGET_ROUTE_TRIES 64  // --ketama draws per multi-get key.
+#define MIX_APPEND_LEN 16    // Bytes an --ops append or prepend adds.
 
 int ConnectionStats::details[]={5,10,50,67,75,80,85,90,95,99,999,9999};
 int ConnectionStats::ndetails=sizeof(ConnectionStats::details)/sizeof(int);
 
 Connection::Connection(struct event_base* _base, struct evdns_base* _evdns,
                        string _hostname, string _port, options_t _options,
-                       bool sampling, 
-					   int key_capacity, int key_reuse, int key_regen) :
+                       bool sampling, int key_reuse) :
   hostname(_hostname), port(_port), start_time(0),
-  stats(sampling), options(_options), base(_base), evdns(_evdns), read_state(INIT_READ)
+  stats(sampling, _options.size_buckets), options(_options), base(_base),
+  evdns(_evdns), read_state(INIT_READ),
+  popularity(_options), phase(POP_NONE), outstanding(0), origin(NULL)
 {
-  valuesize = createGenerator(options.valuesize);
-  keysize = createGenerator(options.keysize);
+  // Seeded from the thread's stream in creation order, so each
+  // connection sees the same numbers however the ops interleave.
+  rng_seed(&rng, rng_next(), 0);
+  rng_current = &rng;
+
+  valuesize = createTabulated(createGenerator(options.valuesize),
+                              options.cdf_table, options.cdf_table_error,
+                              options.cdf_table_nearest);
+  keysize = createTabulated(createGenerator(options.keysize),
+                            options.cdf_table, options.cdf_table_error,
+                            options.cdf_table_nearest);
   keyorder = createGenerator(options.keyorder);
-  if (key_capacity>0) {
-	keygen=new CachingKeyGenerator(keysize, keyorder, options.records, key_capacity, key_reuse, key_regen);
-  } else {
-	keygen=new CachingKeyGenerator(keysize, keyorder, options.records);
+  latest = dynamic_cast<Latest*>(keyorder);
+  if (latest) {
+    latest->set_items(options.records);
+    latest->share(&latest_head);
   }
-  loadgen=new KeyGenerator(keysize,options.records);
+  // issue_latest() draws its own keys, so it leaves the pool alone:
+  // a cursor that never fetches would hold up its regenerations.
+  if (key_pool && !latest)
+    keygen=new CachingKeyGenerator(key_pool, key_reuse);
+  else
+    keygen=new CachingKeyGenerator(keysize, keyorder, options.records, dataset);
+  loadgen=new KeyGenerator(keysize,options.records,dataset);
+  rng_current = NULL;
 
   if (options.lambda <= 0) {
     iagen = createGenerator("0");
   } else {
     D("iagen = createGenerator(%s)", options.ia);
-    iagen = createGenerator(options.ia);
+    iagen = createTabulated(createGenerator(options.ia), options.cdf_table,
+                            options.cdf_table_error,
+                            options.cdf_table_nearest);
     iagen->set_lambda(options.lambda);
   }
 
@@ -53,6 +77,31 @@ Connection::Connection(struct event_base* _base, struct evdns_base* _evdns,
 
   last_tx = last_rx = 0.0;
 
+  loader_issued = loader_completed = loader_errors = window_errors = 0;
+  loader_bytes = 0;
+  loader_cursor = NULL;
+
+  recorder = NULL;
+  record_id = 0;
+
+  router = NULL;
+  server_id = 0;
+
+  mix = options.ops[0] ? new OpMix(options.ops) : NULL;
+  counters = mix && !dataset && mix->share(Operation::INCR) +
+    mix->share(Operation::DECR) > 0.0;
+  if (mix && mix->share(Operation::CAS) > 0.0) {
+    unique_t empty = { 0, 0, 0 };
+    uniques.assign(CAS_SLOTS, empty);
+  }
+
+  rng_current = &rng;
+  fillgen = options.fill[0] ? createGenerator(options.fill) : NULL;
+  ttlgen = options.ttl[0] ? createGenerator(options.ttl) : NULL;
+  rng_current = NULL;
+
+  ia_next = vs_next = GEN_BATCH;
+
   bev = bufferevent_socket_new(base, -1, BEV_OPT_CLOSE_ON_FREE);
   bufferevent_setcb(bev, bev_read_cb, bev_write_cb, bev_event_cb, this);
   bufferevent_enable(bev, EV_READ | EV_WRITE);
@@ -63,18 +112,26 @@ Connection::Connection(struct event_base* _base, struct evdns_base* _evdns,
     DIE("bufferevent_socket_connect_hostname()");
 
   timer = evtimer_new(base, timer_cb, this);
+  fill_timer = evtimer_new(base, fill_timer_cb, this);
 }
 
 Connection::~Connection() {
+  if (rng_current == &rng) rng_current = NULL;
+
   event_free(timer);
   timer = NULL;
+  event_free(fill_timer);
 
   // FIXME:  W("Drain op_q?");
 
   bufferevent_free(bev);
 
+  delete fillgen;
+  delete ttlgen;
+  delete mix;
   delete iagen;
   delete keygen;
+  delete keyorder;
   delete keysize;
   delete valuesize;
 }
@@ -83,9 +140,11 @@ void Connection::reset() {
   // FIXME: Actually check the connection, drain all bufferevents, drain op_q.
   assert(op_queue.size() == 0);
   evtimer_del(timer);
+  evtimer_del(fill_timer);
+  while (!fills.empty()) fills.pop();
   read_state = IDLE;
   write_state = INIT_WRITE;
-  stats = ConnectionStats(stats.sampling);
+  stats = ConnectionStats(stats.sampling, stats.size_mode);
 }
 
 void Connection::issue_command(char *cmd) {
@@ -108,7 +167,11 @@ void Connection::issue_sasl() {
   bufferevent_write(bev, password.c_str(), password.length());
 }
 
-void Connection::issue_get_req(const char* key, const char *req, double now) {
+// Requests are written straight into reserved space of the output
+// buffer, with the key rendered in place from its (index, length): no
+// std::string and no printf on the request path.
+
+void Connection::issue_get(const key_ref_t &k, double now) {
   Operation op;
   int l;
   op.n_req=1;
@@ -130,43 +193,133 @@ void Connection::issue_get_req(const char* key, const char *req, double now) {
   }
 #endif
   op.type = Operation::GET;
-  op.key = string(key);
+  op.key = k.index;
+  op.key_len = k.len;
+  tag_op(op);
   op_queue.push(op);
 
   if (read_state == IDLE)
     read_state = WAITING_FOR_GET;
 
+  struct evbuffer *output = bufferevent_get_output(bev);
+  struct evbuffer_iovec v;
+
   if (options.binary) {
-    uint16_t keylen = strlen(key);
     // each line is 4-bytes
-    binary_header_t h = {0x80, CMD_GET, htons(keylen),
+    binary_header_t h = {0x80, CMD_GET, htons(k.len),
                          0x00, 0x00, {htons(0)}, 
-                         htonl(keylen) };
+                         htonl(k.len) };
 
-    bufferevent_write(bev, &h, 24); // size does not include extras
-    bufferevent_write(bev, key, keylen);
-    l = 24 + keylen;
+    l = 24 + k.len;
+    evbuffer_reserve_space(output, l, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, &h, 24); // size does not include extras
+    loadgen->render(k, p + 24);
   } else {
-    if (req == NULL) {
-		l = evbuffer_add_printf(bufferevent_get_output(bev), "get %s\r\n", key);
-    } else {
-    	l = evbuffer_add(bufferevent_get_output(bev), req, strlen(req));
-    }
+    l = 4 + k.len + 2;
+    evbuffer_reserve_space(output, l, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, "get ", 4);
+    loadgen->render(k, p + 4);
+    memcpy(p + 4 + k.len, "\r\n", 2);
   }
+  v.iov_len = l;
+  evbuffer_commit_space(output, &v, 1);
 
   if (read_state != LOADING) stats.tx_bytes += l;
 
 }
 
-void Connection::issue_get(const char* key, double now) {
-	Connection::issue_get_req(key,NULL,now);
+void Connection::issue_multi_get(int nkeys, double now) {
+  if (nkeys > MAX_MGET_KEYS) nkeys = MAX_MGET_KEYS;
+
+  // Any nkeys keys of the key cache.
+  key_ref_t keys[MAX_MGET_KEYS];
+  int owners[MAX_MGET_KEYS];
+  for (int n=0; n<nkeys; n++) {
+    // With --ketama, only keys this server owns, unless they fan out.
+    for (int tries = 0; tries < MGET_ROUTE_TRIES; tries++) {
+      keys[n] = keygen->at(rng_next());
+      if (popularity.active())
+        keys[n] = loadgen->ref(popularity.index(keys[n].index,
+                                                now - start_time));
+      if (router == NULL || options.fanout) break;
+      if ((owners[n] = owner(keys[n])) == server_id) break;
+    }
+  }
+
+  if (router && options.fanout) issue_fanout(keys, nkeys, now);
+  else if (router) issue_routed(keys, owners, nkeys, now);
+  else issue_mget(keys, nkeys, now);
+}
+
+// --ketama without --fanout: the keys this server owns in one multi-get,
+// and the few that no draw could find for it in one multi-get to each
+// of their owners, so none of them misses.
+void Connection::issue_routed(const key_ref_t *keys, const int *owners,
+                              int nkeys, double now) {
+  key_ref_t part[MAX_MGET_KEYS];
+  int m = 0;
+  for (int n = 0; n < nkeys; n++)
+    if (owners[n] == server_id) part[m++] = keys[n];
+  if (m == nkeys) {
+    issue_mget(keys, nkeys, now);
+    return;
+  }
+  if (m) issue_mget(part, m, now);
+
+  for (size_t s = 0; s < router->servers.size(); s++) {
+    if ((int) s == server_id) continue;
+    m = 0;
+    for (int n = 0; n < nkeys; n++)
+      if (owners[n] == (int) s) part[m++] = keys[n];
+    if (m == 0) continue;
+
+    std::vector<Connection*> &conns = router->servers[s];
+    Connection *c = conns[router->next[s]++ % conns.size()];
+    c->phase = phase;
+    c->origin = this;
+    c->issue_mget(part, m, now);
+  }
+}
+
+// --fanout: split the keys by owning server and send each server its
+// part on one of this thread's connections to it.  The request is
+// complete when the last part is.
+void Connection::issue_fanout(const key_ref_t *keys, int nkeys, double now) {
+  key_ref_t part[MAX_MGET_KEYS];
+  int owners[MAX_MGET_KEYS];
+  size_t servers = router->servers.size();
+
+  for (int n = 0; n < nkeys; n++) owners[n] = owner(keys[n]);
+
+  fanout_t *f = new fanout_t;
+  f->start_time = 0.0;  // That of the first part.
+  f->parts = 0;
+
+  for (size_t s = 0; s < servers; s++) {
+    int m = 0;
+    for (int n = 0; n < nkeys; n++)
+      if (owners[n] == (int) s) part[m++] = keys[n];
+    if (m == 0) continue;
+
+    std::vector<Connection*> &conns = router->servers[s];
+    Connection *c = conns[router->next[s]++ % conns.size()];
+    c->phase = phase;
+    c->origin = this;
+    f->parts++;
+    c->issue_mget(part, m, now, f);
+  }
+
+  stats.fanouts++;
+  stats.fanout_parts += f->parts;
 }
 
-void Connection::issue_multi_get(int nkeys, double now) {
+// One multi-get of keys on this connection, a part of f if not NULL.
+void Connection::issue_mget(const key_ref_t *keys, int nkeys, double now,
+                            fanout_t *f) {
   Operation op;
   int l=0;
-  char* key;
-  uint16_t keylen ;
   op.n_recv=0;
   op.n_req=1;
 
@@ -189,61 +342,68 @@ void Connection::issue_multi_get(int nkeys, double now) {
 
 	op.type = Operation::GET;
 	op.n_req=nkeys;
+	op.multi = true;
+	op.fanout = f;
+	if (f && f->start_time == 0.0) f->start_time = op.start_time;
+	tag_op(op);
 	op_queue.push(op);
 
 
   if (read_state == IDLE)
     read_state = WAITING_FOR_GET;
 
+  int n, keylen = 0;
+  for (n=0; n<nkeys; n++) keylen += keys[n].len;
+
+  struct evbuffer *output = bufferevent_get_output(bev);
+  struct evbuffer_iovec v;
+  char *p;
+
   if (options.binary) {
-	int n;
     // each line is 4-bytes
-    binary_header_t h = {0x80, CMD_MGET, htons(keylen),
+    binary_header_t h = {0x80, CMD_MGET, 0,
                          0x00, 0x00, {htons(0)}, //TODO(syang0) get actual vbucket?
-                         htonl(keylen) };
+                         0 };
 
     binary_header_t nh = {0x80, CMD_NOOP, 0,
                          0x00, 0x00, {htons(0)}, //TODO(syang0) get actual vbucket?
                          0 };
-						 
+
+    l = 24 * (nkeys + 1) + keylen;
+    evbuffer_reserve_space(output, l, &v, 1);
+    p = (char *) v.iov_base;
 	for (n=0; n<nkeys; n++) {
-		op.key = keygen->generate(lrand48() % options.records);
-		keylen=op.key.size();
-		h.key_len=htons(keylen);
-		//op_queue.push(op);
-		bufferevent_write(bev, &h, 24); // size does not include extras
-		bufferevent_write(bev, op.key.c_str(), keylen);
-		l += 24 + keylen;
+		h.key_len=htons(keys[n].len);
+		h.body_len=htonl(keys[n].len);
+		memcpy(p, &h, 24); // size does not include extras
+		keygen->render(keys[n], p + 24);
+		p += 24 + keys[n].len;
 	}
 	// Last, flush with NOOP
-		bufferevent_write(bev, &nh, 24); // size does not include extras
-		l += 24;
+	memcpy(p, &nh, 24); // size does not include extras
   } else {
-	int n,keylen=0;
-	char keys[MAX_KEY_LEN * MAX_MGET_KEYS];
-	char *p=keys;
+    l = 3 + nkeys + keylen + 2;
+    evbuffer_reserve_space(output, l, &v, 1);
+    p = (char *) v.iov_base;
+    memcpy(p, "get", 3);
+    p += 3;
 	for (n=0; n<nkeys; n++) {
-		op.key = keygen->generate(lrand48() % options.records);
-		int curlen=op.key.size();
-		keylen+=curlen+1;
-		if (keylen > (MAX_KEY_LEN * MAX_MGET_KEYS))
-			break;
-		//op_queue.push(op);
-		sprintf(p,"%s ",op.key.c_str());
-		p+=curlen+1;
+		*p++ = ' ';
+		keygen->render(keys[n], p);
+		p += keys[n].len;
 	}
-	op.n_req=nkeys;
-    l = evbuffer_add_printf(bufferevent_get_output(bev), "get %s\r\n", keys);
+    memcpy(p, "\r\n", 2);
   }
+  v.iov_len = l;
+  evbuffer_commit_space(output, &v, 1);
 
   if (read_state != LOADING) stats.tx_bytes += l;
 }
 
-void Connection::issue_set(const char* key, const char* value, int length,
+void Connection::issue_set(const key_ref_t &k, const char* value, int length,
                            double now) {
   Operation op;
   int l;
-  uint16_t keylen = strlen(key);
 
 #if HAVE_CLOCK_GETTIME
   op.start_time = get_time_accurate();
@@ -253,26 +413,48 @@ void Connection::issue_set(const char* key, const char* value, int length,
 #endif
 
   op.type = Operation::SET;
+  op.value_size = length;
+  op.key = k.index;
+  op.key_len = k.len;
+  tag_op(op);
   op_queue.push(op);
 
   if (read_state == IDLE)
     read_state = WAITING_FOR_SET;
 
+  struct evbuffer *output = bufferevent_get_output(bev);
+  struct evbuffer_iovec v;
+
   if (options.binary) {
     // each line is 4-bytes
-    binary_header_t h = { 0x80, CMD_SET, htons(keylen),
+    binary_header_t h = { 0x80, CMD_SET, htons(k.len),
                           0x08, 0x00, {htons(0)}, //TODO(syang0) get actual vbucket?
-                          htonl(keylen + 8 + length)};
-
-    bufferevent_write(bev, &h, 32); // With extras
-    bufferevent_write(bev, key, keylen);
-    bufferevent_write(bev, value, length);
-    l = 24 + h.body_len;
+                          htonl(k.len + 8 + length)};
+    h.extras = htobe64(next_ttl());  // Flags 0, then the expiration.
+
+    evbuffer_reserve_space(output, 32 + k.len, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, &h, 32); // With extras
+    loadgen->render(k, p + 32);
+    v.iov_len = 32 + k.len;
+    evbuffer_commit_space(output, &v, 1);
+    evbuffer_add(output, value, length);
+    l = 24 + 8 + k.len + length;
   } else {
-    l = evbuffer_add_printf(bufferevent_get_output(bev),
-                                "set %s 0 0 %d\r\n", key, length);
-    bufferevent_write(bev, value, length);
-    bufferevent_write(bev, "\r\n", 2);
+    // "set <key> 0 <exptime> <length>\r\n"
+    evbuffer_reserve_space(output, 4 + k.len + 15 + 20 + 2, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, "set ", 4);
+    loadgen->render(k, p + 4);
+    l = 4 + k.len;
+    l += render_exptime(p + l);
+    l += format_u64(p + l, length);
+    memcpy(p + l, "\r\n", 2);
+    l += 2;
+    v.iov_len = l;
+    evbuffer_commit_space(output, &v, 1);
+    evbuffer_add(output, value, length);
+    evbuffer_add(output, "\r\n", 2);
     l += length + 2;
   }
 
@@ -280,28 +462,401 @@ void Connection::issue_set(const char* key, const char* value, int length,
 }
 
 void Connection::issue_something(double now) {
-	const char *key = keygen->generate_next();
+	phase = popularity.phase(now - start_time);
+	if (latest) {
+		issue_latest(now);
+		return;
+	}
+	key_ref_t key = keygen->generate_next();
+	if (popularity.active())
+		key = loadgen->ref(popularity.index(key.index, now - start_time));
+	if (mix) {
+		issue_mixed(key, now);
+		return;
+	}
 	if ((options.update > 0) || (options.getq_freq > 0)) {
-  		if (drand48() < options.update) {
-	    	int index = lrand48() % (1024 * 1024);
-			issue_set(key, &random_char[index], valuesize->generate(), now);
+  		if (rng_double() < options.update) {
+			int length;
+			const char *value = update_value(key, &length);
+			if (recorder)
+				recorder->log(next_time - start_time, key.index, TRACE_SET,
+				              length, record_id);
+			route(key)->issue_set(key, value, length, now);
 			return;
 		} else {
-			if (drand48() < options.getq_freq) {
+			if (rng_double() < options.getq_freq) {
 				issue_multi_get(options.getq_size,now);
 				return;
 			}
 		}
 		//Otherwise fall through to simple get
 	} 
-	const char *req = keygen->current_get_req();
-	issue_get_req(key, req, now);
+	if (recorder)
+		recorder->log(next_time - start_time, key.index, TRACE_GET, 0,
+		              record_id);
+	route(key)->issue_get(key, now);
+}
+
+// The value an update of key writes: with --dataset the same shape as
+// the loaded record, else one of the value size distribution.
+const char *Connection::update_value(const key_ref_t &key, int *length) {
+  int index = rng_next() % (1024 * 1024);
+  const char *value = NULL;
+
+  if (dataset) {
+    value = dataset->value(key.index);
+    *length = dataset->value_length(key.index);
+    if (value == NULL) *length = MIN(*length, 1024 * 1024);
+  } else {
+    *length = next_value_size();
+  }
+  return value ? value : &random_char[index];
+}
+
+// --ops: one op of the mix on key.
+void Connection::issue_mixed(const key_ref_t &key, double now) {
+  int type = mix->draw();
+  int length = MIX_APPEND_LEN;
+  const char *value = &random_char[rng_next() % (1024 * 1024)];
+
+  switch (type) {
+  case Operation::GET:
+    if (options.getq_freq > 0 && rng_double() < options.getq_freq)
+      issue_multi_get(options.getq_size, now);
+    else
+      route(key)->issue_get(key, now);
+    return;
+  case Operation::SET:
+    value = update_value(key, &length);
+    route(key)->issue_set(key, value, length, now);
+    return;
+  case Operation::INCR:
+  case Operation::DECR:
+    if (counters) {
+      key_ref_t c = counter_key(key);
+      route(c)->issue_op((Operation::type_enum) type, c, NULL, 0, now);
+      return;
+    }
+    break;
+  case Operation::CAS:
+    issue_lone_cas(key, now);
+    return;
+  case Operation::RMW: {
+    rmw_t *r = new rmw_t;
+    r->start_time = 0.0;
+    r->key = key.index;
+    r->key_len = key.len;
+    r->value = update_value(key, &r->value_len);
+    r->cas = 0;
+    r->retries = 0;
+    route(key)->issue_op(Operation::GETS, key, NULL, 0, now, r);
+    return;
+  }
+  }
+  route(key)->issue_op((Operation::type_enum) type, key, value, length, now);
+}
+
+// --ops cas: a cas of a key this connection fetched lately, with the
+// unique it got, as a client updating what it has read would.  The
+// slot is emptied, so the next cas of it fetches again unless the
+// (binary) reply brings the new unique; an empty slot sends a gets of
+// key instead.  Writes in between make it meet EXISTS.
+void Connection::issue_lone_cas(const key_ref_t &key, double now) {
+  unique_t &u = uniques[rng_next() % uniques.size()];
+  if (u.cas == 0) {
+    route(key)->issue_op(Operation::GETS, key, NULL, 0, now);
+    return;
+  }
+
+  key_ref_t k = loadgen->ref(u.key, u.key_len);
+  uint64_t cas = u.cas;
+  int length;
+  const char *value = update_value(k, &length);
+  u.cas = 0;
+  route(k)->issue_op(Operation::CAS, k, value, length, now, NULL, cas);
+}
+
+// --ops rmw: go on with op's update now that its reply (status, as in
+// the binary protocol) is in.  A gets hit is followed by a cas with its
+// unique, a cas that meets EXISTS by another gets, until it stores or
+// runs out of --rmw_retries.  The next step is queued before op is
+// popped, so the update keeps its place within --depth throughout.
+void Connection::rmw_step(Operation &op, int status) {
+  rmw_t *r = op.rmw;
+  key_ref_t key = loadgen->ref(r->key, r->key_len);
+
+  phase = op.phase;
+  if (op.type == Operation::GETS && op.cas) {
+    r->cas = op.cas;
+    stats.rmw_attempts++;
+    origin = op.origin;
+    issue_op(Operation::CAS, key, r->value, r->value_len, 0.0, r);
+    return;
+  }
+  if (op.type == Operation::CAS && status == RESP_EXISTS) {
+    stats.rmw_conflicts++;
+    if (r->retries < options.rmw_retries) {
+      r->retries++;
+      origin = op.origin;
+      issue_op(Operation::GETS, key, NULL, 0, 0.0, r);
+      return;
+    }
+    stats.rmw_aborts++;
+  }
+
+  // Done: stored, gave up, or the key is gone (a gets or cas miss).
+  bool stored = op.type == Operation::CAS && status == RESP_OK;
+  Operation done;
+  done.type = Operation::RMW;
+  done.start_time = r->start_time;
+  done.end_time = op.end_time;
+  done.phase = op.phase;
+  if (!stored && status != RESP_EXISTS) stats.type_misses[Operation::RMW]++;
+  stats.log_rmw(done, stored, r->retries);
+  delete r;
+}
+
+// --ops incr/decr: the counter of key, one of a second keyspace right
+// after the records that only counters use, so no set or append turns
+// it back into text.  The loader stores "0" in each, with --noload too.
+// With --dataset the counters are the dataset's own keys.
+key_ref_t Connection::counter_key(const key_ref_t &key) {
+  return loadgen->ref(options.records + key.index);
+}
+
+// --ops: any op but a get or a set.  value and length are the data of
+// an append, prepend or cas.  Counters step by 1; in binary one that is
+// gone (evicted, expired) is created again at 0.  touch, gat and cas
+// set the --ttl expiration.  A cas sends the unique its rmw's gets
+// returned, or that of a lone cas.
+void Connection::issue_op(Operation::type_enum type, const key_ref_t &k,
+                          const char *value, int length, double now,
+                          rmw_t *rmw, uint64_t cas) {
+  static const uint8_t opcodes[OP_TYPES] = {
+    CMD_GET, CMD_SET, CMD_DELETE, CMD_INCR, CMD_DECR, CMD_APPEND,
+    CMD_PREPEND, CMD_TOUCH, CMD_GAT, CMD_SET, CMD_GET, 0, CMD_SET };
+  static const char *verbs[OP_TYPES] = {
+    "get ", "set ", "delete ", "incr ", "decr ", "append ", "prepend ",
+    "touch ", "gat ", "cas ", "gets ", NULL, "set " };
+  uint64_t unique = rmw ? rmw->cas : cas;
+  uint32_t ttl = 0;
+  bool data = type == Operation::APPEND || type == Operation::PREPEND ||
+    type == Operation::CAS || type == Operation::FILL;
+  Operation op;
+  int l;
+
+#if HAVE_CLOCK_GETTIME
+  op.start_time = get_time_accurate();
+#else
+  if (now == 0.0) op.start_time = get_time();
+  else op.start_time = now;
+#endif
+
+  op.type = type;
+  op.key = k.index;
+  op.key_len = k.len;
+  op.rmw = rmw;
+  if (rmw && rmw->start_time == 0.0) rmw->start_time = op.start_time;
+  tag_op(op);
+  op_queue.push(op);
+
+  if (read_state == IDLE)
+    read_state = type == Operation::GAT || type == Operation::GETS ?
+      WAITING_FOR_GET : WAITING_FOR_REPLY;
+
+  struct evbuffer *output = bufferevent_get_output(bev);
+  struct evbuffer_iovec v;
+
+  evbuffer_reserve_space(output, 64 + k.len, &v, 1);
+  char *p = (char *) v.iov_base;
+
+  if (options.binary) {
+    binary_header_t h = { 0x80, opcodes[type], htons(k.len),
+                          0x00, 0x00, {htons(0)}, 0 };
+    char *e = p + 24;
+    uint64_t delta = htobe64(1), initial = 0;
+
+    switch (type) {
+    case Operation::INCR:
+    case Operation::DECR:
+      // A missing counter is created at initial, as the loader's.
+      h.extra_len = 20;
+      memcpy(e, &delta, 8);
+      memcpy(e + 8, &initial, 8);
+      ttl = htonl(next_ttl());
+      memcpy(e + 16, &ttl, 4);
+      break;
+    case Operation::TOUCH:
+    case Operation::GAT:
+      h.extra_len = 4;
+      ttl = htonl(next_ttl());
+      memcpy(e, &ttl, 4);
+      break;
+    case Operation::CAS:
+    case Operation::FILL:
+      h.extra_len = 8;
+      memset(e, 0, 4);
+      ttl = htonl(next_ttl());
+      memcpy(e + 4, &ttl, 4);
+      if (type == Operation::CAS) h.version = htobe64(unique);
+      break;
+    default:
+      break;
+    }
+    h.body_len = htonl(h.extra_len + k.len + (data ? length : 0));
+    memcpy(p, &h, 24);
+    loadgen->render(k, e + h.extra_len);
+    l = 24 + h.extra_len + k.len;
+  } else {
+    // "<verb> <key>[ <args>]\r\n", "gat <exptime> <key>\r\n"
+    l = strlen(verbs[type]);
+    memcpy(p, verbs[type], l);
+    if (type == Operation::GAT) {
+      l += format_u64(p + l, next_ttl());
+      p[l++] = ' ';
+    }
+    loadgen->render(k, p + l);
+    l += k.len;
+    if (type == Operation::INCR || type == Operation::DECR) {
+      memcpy(p + l, " 1", 2);
+      l += 2;
+    } else if (type == Operation::TOUCH) {
+      p[l++] = ' ';
+      l += format_u64(p + l, next_ttl());
+    } else if (data) {
+      l += render_exptime(p + l);
+      l += format_u64(p + l, length);
+      if (type == Operation::CAS) {
+        p[l++] = ' ';
+        l += format_u64(p + l, unique);
+      }
+    }
+    memcpy(p + l, "\r\n", 2);
+    l += 2;
+  }
+  v.iov_len = l;
+  evbuffer_commit_space(output, &v, 1);
+
+  if (data) {
+    evbuffer_add(output, value, length);
+    l += length;
+    if (!options.binary) {
+      evbuffer_add(output, "\r\n", 2);
+      l += 2;
+    }
+  }
+
+  if (read_state != LOADING) stats.tx_bytes += l;
+}
+
+// --keyorder=latest: the hot set moves with every insert, so the key
+// is picked per op instead of coming from the key cache.  Updates
+// insert at the head, gets are Zipf distributed behind it.
+void Connection::issue_latest(double now) {
+  bool update = rng_double() < options.update;
+  uint64_t i = update ? latest->insert() : (uint64_t) latest->generate();
+  key_ref_t key = loadgen->ref(i);
+
+  if (update) {
+    int index = rng_next() % (1024 * 1024);
+    int length = dataset ? dataset->value_length(i) : next_value_size();
+    const char *value = dataset ? dataset->value(i) : NULL;
+    if (value == NULL) {
+      value = &random_char[index];
+      length = MIN(length, 1024 * 1024);
+    }
+    if (recorder)
+      recorder->log(next_time - start_time, i, TRACE_SET, length, record_id);
+    route(key)->issue_set(key, value, length, now);
+  } else {
+    if (recorder)
+      recorder->log(next_time - start_time, i, TRACE_GET, 0, record_id);
+    route(key)->issue_get(key, now);
+  }
+}
+
+// --ketama: index of the server owning key.
+int Connection::owner(const key_ref_t &key) {
+  char buf[max_memcached_len];
+  loadgen->render(key, buf);
+  return router->continuum->server(buf, key.len);
+}
+
+// The connection of this thread that key is sent on: this one, or with
+// --ketama one to the server owning it.  The op is charged to this
+// connection's --depth either way.
+Connection *Connection::route(const key_ref_t &key) {
+  if (router == NULL) return this;
+
+  Connection *c = this;
+  int s = owner(key);
+  if (s != server_id) {
+    std::vector<Connection*> &conns = router->servers[s];
+    c = conns[router->next[s]++ % conns.size()];
+    c->phase = phase;
+  }
+  c->origin = this;
+  return c;
+}
+
+// Stamp a request with its --flash_crowd phase and its issuer.
+void Connection::tag_op(Operation &op) {
+  op.phase = phase;
+  if (origin == NULL && router) origin = this;
+  if (origin) {
+    op.origin = origin;
+    origin->outstanding++;
+    origin = NULL;
+  }
+}
+
+// Issue one op of a --replay trace.
+void Connection::issue_replay(const trace_record_t *r, double now) {
+  rng_current = &rng;
+
+  key_ref_t key = loadgen->ref(r->key, r->key_len);
+
+  if (r->op == TRACE_SET) {
+    int index = rng_next() % (1024 * 1024);
+    issue_set(key, &random_char[index], MIN(r->value_size, 1024 * 1024), now);
+  } else {
+    issue_get(key, now);
+  }
 }
 
 void Connection::pop_op() {
   assert(op_queue.size() > 0);
 
+  Operation &done = op_queue.front();
+  Connection *o = done.origin;
+
+  // The end-to-end latency of a --fanout request is that of its last
+  // part, charged to the connection that issued it.
+  if (done.fanout) {
+    stats.log_shard(done);
+    if (--done.fanout->parts == 0) {
+      o->stats.log_fanout(done.end_time - done.fanout->start_time);
+      delete done.fanout;
+    }
+  }
+
+  // As the server counts them: a multi-get is a get of every key.
+  if (read_state != LOADING) stats.requests += done.multi ? done.n_req : 1;
+
+  // --ops cas: remember the unique for the issuer, but not those of
+  // counters, which a cas would turn into text.
+  Connection *t = o ? o : this;
+  if (done.cas && t->uniques.size() && !done.multi &&
+      read_state != LOADING && done.type != Operation::INCR &&
+      done.type != Operation::DECR) {
+    unique_t &u = t->uniques[done.key % CAS_SLOTS];
+    u.key = done.key;
+    u.key_len = done.key_len;
+    u.cas = done.cas;
+  }
+
   op_queue.pop();
+  if (o) o->outstanding--;
 
   if (read_state == LOADING) return;
   read_state = IDLE;
@@ -310,12 +865,26 @@ void Connection::pop_op() {
   if (op_queue.size() > 0) {
     Operation& op = op_queue.front();
     switch (op.type) {
-    case Operation::GET: read_state = WAITING_FOR_GET; break;
+    case Operation::GET:
+    case Operation::GAT:
+    case Operation::GETS: read_state = WAITING_FOR_GET; break;
     case Operation::SET: read_state = WAITING_FOR_SET; break;
+    case Operation::DELETE:
+    case Operation::INCR:
+    case Operation::DECR:
+    case Operation::APPEND:
+    case Operation::PREPEND:
+    case Operation::TOUCH:
+    case Operation::CAS:
+    case Operation::FILL: read_state = WAITING_FOR_REPLY; break;
     default: DIE("Not implemented.");
     }
   }
   D("Pop op = %d\n",read_state);
+
+  // A routed op frees --depth on its issuer, which may be waiting on it.
+  if (o && o != this && o->write_state == WAITING_FOR_OPQ)
+    o->drive_write_machine();
 }
 
 bool Connection::check_exit_condition(double now) {
@@ -331,6 +900,11 @@ bool Connection::check_exit_condition(double now) {
 // vs. return.
 
 void Connection::drive_write_machine(double now) {
+  rng_current = &rng;
+
+  // With --replay the TraceReplayer issues all the ops.
+  if (options.replay[0]) return;
+
   if (now == 0.0) now = get_time();
 
   double delay;
@@ -341,7 +915,7 @@ void Connection::drive_write_machine(double now) {
   while (1) {
     switch (write_state) {
     case INIT_WRITE:
-      delay = iagen->generate();
+      delay = next_gap();
 
       next_time = now + delay;
       double_to_tv(delay, &tv);
@@ -351,7 +925,7 @@ void Connection::drive_write_machine(double now) {
       break;
 
     case ISSUING:
-      if (op_queue.size() >= (size_t) options.depth) {
+      if (in_flight() >= (size_t) options.depth) {
         write_state = WAITING_FOR_OPQ;
         return;
       } else if (now < next_time) {
@@ -376,17 +950,17 @@ void Connection::drive_write_machine(double now) {
 
       issue_something(now);
       last_tx = now;
-      stats.log_op(op_queue.size());
+      stats.log_op(in_flight());
 
-      next_time += iagen->generate();
+      next_time += next_gap();
 
       if (options.skip && options.lambda > 0.0 &&
           now - next_time > 0.005000 &&
-          op_queue.size() >= (size_t) options.depth) {
+          in_flight() >= (size_t) options.depth) {
 
         while (next_time < now - 0.004000) {
           stats.skips++;
-          next_time += iagen->generate();
+          next_time += next_gap();
         }
       }
 
@@ -406,7 +980,7 @@ void Connection::drive_write_machine(double now) {
       break;
 
     case WAITING_FOR_OPQ:
-      if (op_queue.size() >= (size_t) options.depth) return;
+      if (in_flight() >= (size_t) options.depth) return;
       write_state = ISSUING;
       break;
 
@@ -444,7 +1018,25 @@ void Connection::event_callback(short events) {
   }
 }
 
+// The ASCII reply to an --ops op as a binary status: RESP_OK if it
+// found its key and acted on it, RESP_EXISTS if a cas lost a race.
+static int reply_status(int type, const char *line) {
+  bool ok;
+
+  switch (type) {
+  case Operation::DELETE: ok = !strcmp(line, "DELETED"); break;
+  case Operation::INCR:
+  case Operation::DECR: ok = isdigit(line[0]); break;
+  case Operation::TOUCH: ok = !strcmp(line, "TOUCHED"); break;
+  default: ok = !strcmp(line, "STORED"); break;
+  }
+  if (ok) return RESP_OK;
+  return strcmp(line, "EXISTS") ? RESP_NOT_FOUND : RESP_EXISTS;
+}
+
 void Connection::read_callback() {
+  rng_current = &rng;
+
   struct evbuffer *input = bufferevent_get_input(bev);
 #if USE_CACHED_TIME
   struct timeval now_tv;
@@ -453,7 +1045,7 @@ void Connection::read_callback() {
 
   char *buf = NULL;
   Operation *op = NULL;
-  int length;
+  int length, status;
   size_t n_read_out;
 
   double now;
@@ -475,7 +1067,13 @@ void Connection::read_callback() {
       assert(op_queue.size() > 0);
 
       if (options.binary) {
-        if (consume_binary_response(input)) {
+        int opcode;
+        if (consume_binary_response(input, &opcode, &status)) {
+          // The hits of a multi-get (GETQ) come first, the NOOP ends it.
+          if (op->multi && opcode != CMD_NOOP) {
+            op->n_recv++;
+            break;
+          }
 #if USE_CACHED_TIME
             now = tv_to_double(&now_tv);
 #else
@@ -486,7 +1084,10 @@ void Connection::read_callback() {
 #else
             op->end_time = now;
 #endif
-            stats.log_get(*op);
+            stats.log_read(*op);
+            if (op->rmw) rmw_step(*op, RESP_OK);
+            if (status && fillgen && op->type == Operation::GET && !op->multi)
+              schedule_fill(*op);
 
             last_rx = now;
             pop_op();
@@ -504,7 +1105,7 @@ void Connection::read_callback() {
 
       if (!strcmp(buf, "END")) {
         //        D("GET (%s) miss.", op->key.c_str());
-        stats.get_misses++;
+        stats.log_miss(*op);
 
 #if USE_CACHED_TIME
         now = tv_to_double(&now_tv);
@@ -517,7 +1118,10 @@ void Connection::read_callback() {
         op->end_time = now;
 #endif
 
-        stats.log_get(*op);
+        stats.log_read(*op);
+        if (op->rmw) rmw_step(*op, RESP_OK);
+        if (fillgen && op->type == Operation::GET && !op->multi)
+          schedule_fill(*op);
 
         free(buf);
 
@@ -527,6 +1131,9 @@ void Connection::read_callback() {
         break;
       } else if (!strncmp(buf, "VALUE", 5)) {
         sscanf(buf, "VALUE %*s %*d %d", &length);
+        if (!op->multi) op->value_size = length;
+        if (op->type == Operation::GETS)
+          sscanf(buf, "VALUE %*s %*d %*d %" SCNu64, &op->cas);
 
         // FIXME: check key name to see if it corresponds to the op at
         // the head of the op queue?  This will be necessary to
@@ -605,7 +1212,8 @@ void Connection::read_callback() {
         op->end_time = now;
 #endif
 
-        stats.log_get(*op);
+        stats.log_read(*op);
+        if (op->rmw) rmw_step(*op, RESP_OK);
 
         free(buf);
 
@@ -647,34 +1255,73 @@ void Connection::read_callback() {
       drive_write_machine(now);
       break;
 
+    case WAITING_FOR_REPLY:
+      assert(op_queue.size() > 0);
+
+      if (options.binary) {
+        if (!consume_binary_response(input, NULL, &status)) return;
+      } else {
+        buf = evbuffer_readln(input, &n_read_out, EVBUFFER_EOL_CRLF);
+        if (buf == NULL) return; // Haven't received a whole line yet. Punt.
+        stats.rx_bytes += n_read_out;
+        status = reply_status(op->type, buf);
+        if (status) stats.log_miss(*op);
+        free(buf);
+      }
+
+      now = get_time();
+
+#if HAVE_CLOCK_GETTIME
+      op->end_time = get_time_accurate();
+#else
+      op->end_time = now;
+#endif
+
+      stats.log_other(*op);
+      if (op->rmw) rmw_step(*op, status);
+
+      last_rx = now;
+      pop_op();
+      drive_write_machine(now);
+      break;
+
     case LOADING:
       assert(op_queue.size() > 0);
 
+      // Quiet sets only answer on failure; anything but the barrier's
+      // reply is an error.
       if (options.binary) {
+        if (evbuffer_get_length(input) < 24) return;
+        uint8_t opcode = evbuffer_pullup(input, 24)[1];
         if (!consume_binary_response(input)) return;
+        if (opcode != CMD_NOOP) {
+          loader_errors++;
+          window_errors++;
+          break;
+        }
       } else {
         buf = evbuffer_readln(input, NULL, EVBUFFER_EOL_CRLF);
         if (buf == NULL) return; // Haven't received a whole line yet.
+        bool barrier = !strncmp(buf, "VERSION", 7);
+        if (!barrier) D("Load error: %s", buf);
         free(buf);
+        if (!barrier) {
+          loader_errors++;
+          window_errors++;
+          break;
+        }
       }
 
-      loader_completed++;
+      // The failures of a window come in before its barrier's reply.
+      // A failed counter set can take it below 0.
+      if ((uint64_t) op->n_req > window_errors)
+        loader_completed += op->n_req - window_errors;
+      window_errors = 0;
       pop_op();
 
-      if (loader_completed == options.records) {
+      if (!issue_load_window() && op_queue.size() == 0) {
         D("Finished loading.");
         read_state = IDLE;
-      } else {
-        while (loader_issued < loader_completed + LOADER_CHUNK) {
-          if (loader_issued >= options.records) break;
-
-          char key[256];
-          string keystr = loadgen->generate(loader_issued);
-          strcpy(key, keystr.c_str());
-          int index = lrand48() % (1024 * 1024);
-          issue_set(key, &random_char[index], valuesize->generate());
-          loader_issued++;
-        }
       }
 
       break;
@@ -694,9 +1341,11 @@ void Connection::read_callback() {
  * Tries to consume a binary response (in its entirety) from an evbuffer.
  *
  * @param input evBuffer to read response from
+ * @param opcode, status  if not NULL, set to those of the response
  * @return  true if consumed, false if not enough data in buffer.
  */
-bool Connection::consume_binary_response(evbuffer *input) {
+bool Connection::consume_binary_response(evbuffer *input, int *opcode,
+                                         int *status) {
   // Read the first 24 bytes as a header
   int length = evbuffer_get_length(input);
   if (length < 24) return false;
@@ -711,8 +1360,9 @@ bool Connection::consume_binary_response(evbuffer *input) {
   }
 
   // if something other than success, count it as a miss
-  if (h->opcode == CMD_GET && h->status) {
-      stats.get_misses++;
+  if (h->status && op_queue.size() > 0 && read_state != LOADING &&
+      h->opcode != CMD_SASL) {
+      stats.log_miss(op_queue.front());
   }
 
   #define unlikely(x)     __builtin_expect((x),0)
@@ -724,6 +1374,18 @@ bool Connection::consume_binary_response(evbuffer *input) {
     }
   }
 
+  if (opcode) *opcode = h->opcode;
+  if (status) *status = ntohs(h->status);
+
+  // The value of a get hit is the body past the extras and the key.
+  if ((h->opcode == CMD_GET || h->opcode == CMD_GAT) && h->status == 0 &&
+      op_queue.size() > 0)
+    op_queue.front().value_size = ntohl(h->body_len) - h->extra_len -
+      ntohs(h->key_len);
+  if (h->status == 0 && h->version) {
+    if (op_queue.size() > 0) op_queue.front().cas = be64toh(h->version);
+  }
+
   evbuffer_drain(input, targetLen);
   stats.rx_bytes += targetLen;
   return true;
@@ -732,6 +1394,66 @@ bool Connection::consume_binary_response(evbuffer *input) {
 void Connection::write_callback() {}
 void Connection::timer_callback() { drive_write_machine(); }
 
+// --ttl: whole seconds, rounded up so that a short draw does not turn
+// into 0 (never expire), and capped where memcached would start taking
+// the exptime for a unix time.
+uint32_t Connection::next_ttl() {
+  if (ttlgen == NULL) return 0;
+  double ttl = ceil(ttlgen->generate());
+  if (ttl <= 0.0) return 0;
+  return ttl < TTL_MAX ? (uint32_t) ttl : TTL_MAX;
+}
+
+// " 0 <exptime> ", the flags and expiration of an ASCII storage command.
+int Connection::render_exptime(char *p) {
+  memcpy(p, " 0 ", 3);
+  int l = 3 + format_u64(p + 3, next_ttl());
+  p[l++] = ' ';
+  return l;
+}
+
+// --fill: the miss of op is answered by the backend after a delay, then
+// the application sets the key.
+void Connection::schedule_fill(const Operation &op) {
+  double delay = fillgen->generate() / 1000000;
+  if (delay < 0.0) delay = 0.0;
+
+  fill_t f;
+  f.due = get_time() + delay;
+  f.key = op.key;
+  f.key_len = op.key_len;
+
+  bool first = fills.empty() || f.due < fills.top().due;
+  fills.push(f);
+  if (first) {
+    struct timeval tv;
+    double_to_tv(delay, &tv);
+    evtimer_add(fill_timer, &tv);
+  }
+}
+
+// Issue the fills that are due and wait for the next one.
+void Connection::fill_callback() {
+  rng_current = &rng;
+
+  double now = get_time();
+  if (check_exit_condition(now)) return;
+
+  while (!fills.empty() && fills.top().due <= now) {
+    key_ref_t key = loadgen->ref(fills.top().key, fills.top().key_len);
+    int length;
+    const char *value = update_value(key, &length);
+    fills.pop();
+    issue_op(Operation::FILL, key, value, length, now);
+  }
+
+  if (!fills.empty()) {
+    struct timeval tv;
+    double_to_tv(fills.top().due - now, &tv);
+    evtimer_add(fill_timer, &tv);
+  }
+}
+
 // The follow are C trampolines for libevent callbacks.
 void bev_event_cb(struct bufferevent *bev, short events, void *ptr) {
   Connection* conn = (Connection*) ptr;
@@ -753,25 +1475,176 @@ void timer_cb(evutil_socket_t fd, short what, void *ptr) {
   conn->timer_callback();
 }
 
+void fill_timer_cb(evutil_socket_t, short, void *ptr) {
+  Connection* conn = (Connection*) ptr;
+  conn->fill_callback();
+}
+
 void Connection::set_priority(int pri) {
   if (bufferevent_priority_set(bev, pri))
     DIE("bufferevent_set_priority(bev, %d) failed", pri);
 }
 
-void Connection::start_loading() {
+void Connection::set_lambda(double lambda) {
+  options.lambda = lambda;
+  iagen->set_lambda(lambda);
+  ia_next = GEN_BATCH;  // Drop the gaps drawn at the old rate.
+}
+
+// Load records claimed from a cursor shared with the other connections
+// to the same server.  The sets are quiet (binary SETQ / ASCII noreply)
+// and each window of LOADER_CHUNK sets is followed by a NOOP / version
+// whose reply acknowledges the whole window.  LOADER_WINDOWS windows
+// are kept in flight.
+void Connection::start_loading(load_cursor_t *cursor) {
+  if (options.noload && !counters) return;
   read_state = LOADING;
-  loader_issued = loader_completed = 0;
-
-  for (int i = 0; i < LOADER_CHUNK; i++) {
-    if (loader_issued >= options.records) break;
-
-    char key[256];
-    int index = lrand48() % (1024 * 1024);
-    string keystr = loadgen->generate(loader_issued);
-    strcpy(key, keystr.c_str());
-          //    generate_key(loader_issued, options.keysize, key);
-    //    issue_set(key, &random_char[index], options.valuesize);
-    issue_set(key, &random_char[index], valuesize->generate());
-    loader_issued++;
+  loader_cursor = cursor;
+  loader_issued = loader_completed = loader_errors = window_errors = 0;
+  loader_bytes = 0;
+
+  for (int i = 0; i < LOADER_WINDOWS; i++)
+    if (!issue_load_window()) break;
+
+  if (op_queue.size() == 0) read_state = IDLE;
+}
+
+// Claim and issue the next window, false if there are no records left.
+// The counters are not records: seeded even with --noload, and left
+// out of the count.
+bool Connection::issue_load_window() {
+  int issued = 0;
+
+  if (router) {
+    if (!route_loads()) return false;
+    std::deque<int64_t> &queue = router->loads[server_id];
+    for (int n = 0; n < LOADER_CHUNK && !queue.empty(); n++) {
+      int64_t i = queue.front();
+      queue.pop_front();
+      if (i >= (int64_t) options.records) {
+        issue_load_set(loadgen->ref(i), "0", 1);
+      } else {
+        issue_load_record(i);
+        issued++;
+      }
+    }
+  } else {
+    int64_t first = __sync_fetch_and_add(&loader_cursor->next, LOADER_CHUNK);
+    if (first >= loader_cursor->last) return false;
+    int64_t last = MIN(first + LOADER_CHUNK, loader_cursor->last);
+
+    for (int64_t i = first; i < last; i++) {
+      if (counters) issue_load_set(counter_key(loadgen->ref(i)), "0", 1);
+      if (options.noload) continue;
+      issue_load_record(i);
+      issued++;
+    }
+  }
+  loader_issued += issued;
+
+  // The barrier; its Operation stands for the whole window.
+  Operation op;
+  op.type = Operation::SET;
+  op.n_req = issued;
+  op_queue.push(op);
+
+  if (options.binary) {
+    binary_header_t h = { 0x80, CMD_NOOP, 0, 0x00, 0x00, {htons(0)}, 0 };
+    bufferevent_write(bev, &h, 24);
+    loader_bytes += 24;
+  } else {
+    loader_bytes += evbuffer_add_printf(bufferevent_get_output(bev),
+                                        "version\r\n");
+  }
+
+  return true;
+}
+
+// --ketama: the servers share one cursor over all records.  Claim
+// windows from it until this server has one queued, hashing each key
+// (and counter) once to queue it for its owner; the connections of the
+// other servers of this thread take theirs from their own queues.
+// False once there is nothing left for this server.
+bool Connection::route_loads() {
+  std::vector<std::deque<int64_t> > &loads = router->loads;
+
+  while (loads[server_id].size() < LOADER_CHUNK) {
+    int64_t first = __sync_fetch_and_add(&loader_cursor->next, LOADER_CHUNK);
+    if (first >= loader_cursor->last) break;
+    int64_t last = MIN(first + LOADER_CHUNK, loader_cursor->last);
+
+    for (int64_t i = first; i < last; i++) {
+      key_ref_t key = loadgen->ref(i);
+      if (counters) {
+        key_ref_t c = counter_key(key);
+        loads[owner(c)].push_back(c.index);
+      }
+      if (!options.noload) loads[owner(key)].push_back(i);
+    }
+  }
+
+  return !loads[server_id].empty();
+}
+
+void Connection::issue_load_record(int64_t i) {
+  key_ref_t key = loadgen->ref(i);
+  int index = rng_next() % (1024 * 1024);
+
+  if (dataset) {
+    const char *value = dataset->value(i);
+    int length = dataset->value_length(i);
+
+    if (value == NULL) {
+      if (length > 1024 * 1024)
+        DIE("--dataset: record %" PRId64 ": %d byte value needs value "
+            "bytes in the file",
+            i, length);
+      value = &random_char[index];
+    }
+    issue_load_set(key, value, length);
+  } else {
+    issue_load_set(key, &random_char[index], valuesize->generate());
+  }
+}
+
+// The value is never copied: it lives in random_char or the --dataset
+// mapping, both of which outlast the connection.
+void Connection::issue_load_set(const key_ref_t &k, const char* value,
+                                int length) {
+  struct evbuffer *output = bufferevent_get_output(bev);
+  struct evbuffer_iovec v;
+  int l;
+
+  if (options.binary) {
+    binary_header_t h = { 0x80, CMD_SETQ, htons(k.len),
+                          0x08, 0x00, {htons(0)},
+                          htonl(k.len + 8 + length)};
+    h.extras = htobe64(next_ttl());
+
+    evbuffer_reserve_space(output, 32 + k.len, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, &h, 32); // With extras
+    loadgen->render(k, p + 32);
+    l = 32 + k.len;
+    v.iov_len = l;
+    evbuffer_commit_space(output, &v, 1);
+    evbuffer_add_reference(output, value, length, NULL, NULL);
+    loader_bytes += l + length;
+  } else {
+    // "set <key> 0 <exptime> <length> noreply\r\n"
+    evbuffer_reserve_space(output, 4 + k.len + 15 + 20 + 10, &v, 1);
+    char *p = (char *) v.iov_base;
+    memcpy(p, "set ", 4);
+    loadgen->render(k, p + 4);
+    l = 4 + k.len;
+    l += render_exptime(p + l);
+    l += format_u64(p + l, length);
+    memcpy(p + l, " noreply\r\n", 10);
+    l += 10;
+    v.iov_len = l;
+    evbuffer_commit_space(output, &v, 1);
+    evbuffer_add_reference(output, value, length, NULL, NULL);
+    evbuffer_add_reference(output, "\r\n", 2, NULL, NULL);
+    loader_bytes += l + length + 2;
   }
 }
@@ -1,7 +1,9 @@
 // -*- c++-mode -*-
 
+#include <deque>
 #include <queue>
 #include <string>
+#include <vector>
 
 #include <event2/bufferevent.h>
 #include <event2/dns.h>
@@ -13,23 +15,73 @@
 #include "ConnectionOptions.h"
 #include "ConnectionStats.h"
 #include "Generator.h"
+#include "Ketama.h"
 #include "KeyGenerator.h"
+#include "OpMix.h"
 #include "Operation.h"
+#include "Popularity.h"
+#include "Trace.h"
 #include "util.h"
 
 using namespace std;
 
+#define GEN_BATCH 256  // Draws per refill of the gap and value size rings.
+#define TTL_MAX 2592000  // Longest relative exptime memcached takes (30 days).
+#define CAS_SLOTS 64  // Uniques a connection keeps for --ops cas.
+
 void bev_event_cb(struct bufferevent *bev, short events, void *ptr);
 void bev_read_cb(struct bufferevent *bev, void *ptr);
 void bev_write_cb(struct bufferevent *bev, void *ptr);
 void timer_cb(evutil_socket_t fd, short what, void *ptr);
+void fill_timer_cb(evutil_socket_t fd, short what, void *ptr);
+
+class Recorder;
+
+// Records [next, last) still to be loaded into one server.  Shared by
+// every connection to that server, which claim LOADER_CHUNK records
+// at a time, so the faster connections simply load more.
+typedef struct {
+  volatile int64_t next;
+  int64_t last;
+} load_cursor_t;
+
+// --fill: a key to set once the backend delay of its miss is over.
+typedef struct {
+  double due;
+  uint64_t key;
+  int key_len;
+} fill_t;
+
+struct fill_later {
+  bool operator()(const fill_t &a, const fill_t &b) { return a.due > b.due; }
+};
+
+// --ops cas: a fetched key and its unique, 0 for an empty slot.
+typedef struct {
+  uint64_t key;
+  int key_len;
+  uint64_t cas;
+} unique_t;
+
+class Connection;
+
+// --ketama: the connections of one thread by server.  An op goes to a
+// connection of the server owning its key, round robin if there are
+// several.  While loading, loads[s] holds the records (and counters)
+// claimed by this thread that server s owns and has yet to load.
+typedef struct {
+  Continuum *continuum;
+  std::vector<std::vector<Connection*> > servers;
+  std::vector<size_t> next;
+  std::vector<std::deque<int64_t> > loads;
+} router_t;
 
 class Connection {
 public:
   Connection(struct event_base* _base, struct evdns_base* _evdns,
              string _hostname, string _port, options_t options,
              bool sampling = true,
-			 int key_capacity=0, int key_reuse=100, int key_regen=1);
+			 int key_reuse=100);
   ~Connection();
 
   string hostname;
@@ -46,6 +98,7 @@ public:
     WAITING_FOR_GET_DATA,
     WAITING_FOR_END,
     WAITING_FOR_SET,
+    WAITING_FOR_REPLY,  // The one line or packet answering an --ops op.
     MAX_READ_STATE,
   };
 
@@ -62,19 +115,24 @@ public:
 
   ConnectionStats stats;
 
-  void issue_get(const char* key, double now = 0.0);
-  void issue_get_req(const char* key, const char *req, double now = 0.0);
+  void issue_get(const key_ref_t &key, double now = 0.0);
   void issue_multi_get(int nkeys=50, double now=0.0);
-  void issue_set(const char* key, const char* value, int length,
+  void issue_mget(const key_ref_t *keys, int nkeys, double now = 0.0,
+                  fanout_t *f = NULL);
+  void issue_set(const key_ref_t &key, const char* value, int length,
                  double now = 0.0);
+  void issue_op(Operation::type_enum type, const key_ref_t &key,
+                const char *value = NULL, int length = 0, double now = 0.0,
+                rmw_t *rmw = NULL, uint64_t cas = 0);
   void issue_something(double now = 0.0);
+  void issue_replay(const trace_record_t *r, double now = 0.0);
   void issue_command(char *cmd);
   void issue_command(char const *cmd) { issue_command(const_cast<char *>(cmd)); }
   void pop_op();
   bool check_exit_condition(double now = 0.0);
   void drive_write_machine(double now = 0.0);
 
-  void start_loading();
+  void start_loading(load_cursor_t *cursor);
 
   void reset();
   void issue_sasl();
@@ -83,14 +141,29 @@ public:
   void read_callback();
   void write_callback();
   void timer_callback();
-  bool consume_binary_response(evbuffer *input);
+  void fill_callback();
+  bool consume_binary_response(evbuffer *input, int *opcode = NULL,
+                               int *status = NULL);
 
   void set_priority(int pri);
+  void set_lambda(double lambda);
 
   options_t options;
 
   std::queue<Operation> op_queue;
 
+  // --record: the thread's recorder and this connection's trace id.
+  Recorder *recorder;
+  int record_id;
+
+  // --ketama: the thread's router and the server of this connection.
+  router_t *router;
+  int server_id;
+
+  // Records loaded by start_loading() and the bytes sent for them.
+  uint64_t loader_completed, loader_errors;
+  uint64_t loader_bytes;
+
 private:
   struct event_base *base;
   struct evdns_base *evdns;
@@ -105,12 +178,82 @@ private:
   int data_length;  // When waiting for data, how much we're peeking for.
 
   // Parameters to track progress of the data loader.
-  int loader_issued, loader_completed;
+  uint64_t loader_issued;
+  uint64_t window_errors;  // Failed sets of the window being acknowledged.
+  load_cursor_t *loader_cursor;
+
+  bool issue_load_window();
+  bool route_loads();
+  void issue_load_record(int64_t i);
+  void issue_latest(double now);
+  void issue_mixed(const key_ref_t &key, double now);
+  void rmw_step(Operation &op, int status);
+  const char *update_value(const key_ref_t &key, int *length);
+  void issue_load_set(const key_ref_t &key, const char* value, int length);
 
   Generator *valuesize;
   Generator *keysize;
   Generator *keyorder;
+  Latest *latest;  // keyorder, if it is "latest".
+
+  // --fill: backend delays and the fills waiting on theirs, earliest
+  // first.  NULL if not given.
+  Generator *fillgen;
+  std::priority_queue<fill_t, std::vector<fill_t>, fill_later> fills;
+  struct event *fill_timer;
+  void schedule_fill(const Operation &op);
+
+  Generator *ttlgen;   // --ttl, NULL if not given.
+  uint32_t next_ttl();
+  int render_exptime(char *p);
+
+  OpMix *mix;          // --ops, NULL if not given.
+  bool counters;       // incr/decr go to counter twins, see counter_key().
+  key_ref_t counter_key(const key_ref_t &key);
+  // --ops cas: the uniques of keys this connection fetched lately, by
+  // key index modulo CAS_SLOTS; empty without cas in the mix.
+  std::vector<unique_t> uniques;
+  void issue_lone_cas(const key_ref_t &key, double now);
+
+  Popularity popularity;  // --key_drift, --flash_crowd.
+  int phase;              // Phase of the op being issued.
+
+  // --ketama: ops issued by this connection and not answered yet,
+  // wherever they were routed, and the issuer of the next op queued here.
+  size_t outstanding;
+  Connection *origin;
+
+  Connection *route(const key_ref_t &key);
+  void issue_fanout(const key_ref_t *keys, int nkeys, double now);
+  void issue_routed(const key_ref_t *keys, const int *owners, int nkeys,
+                    double now);
+  int owner(const key_ref_t &key);
+  void tag_op(Operation &op);
+  size_t in_flight() { return router ? outstanding : op_queue.size(); }
   KeyGenerator *loadgen;
   CachingKeyGenerator *keygen;
   Generator *iagen;
+
+  // Upcoming inter-arrival gaps and value sizes, drawn GEN_BATCH at a
+  // time with Generator::generate_batch().
+  double ia_ring[GEN_BATCH], vs_ring[GEN_BATCH];
+  int ia_next, vs_next;
+
+  double next_gap() {
+    if (ia_next == GEN_BATCH) {
+      iagen->generate_batch(ia_ring, GEN_BATCH);
+      ia_next = 0;
+    }
+    return ia_ring[ia_next++];
+  }
+
+  int next_value_size() {
+    if (vs_next == GEN_BATCH) {
+      valuesize->generate_batch(vs_ring, GEN_BATCH);
+      vs_next = 0;
+    }
+    return (int) vs_ring[vs_next++];
+  }
+
+  rng_t rng;  // This connection's stream, installed while it runs.
 };
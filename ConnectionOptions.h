@@ -8,19 +8,34 @@ typedef struct {
   bool blocking;
   double lambda;
   int qps;
-  int records;
+  uint64_t records;
 
   bool binary;
   bool sasl;
   char username[32];
   char password[32];
 
-  char keysize[32];
-  char valuesize[32];
-  char keyorder[32];
+  // Distributions; 256 bytes so empirical:<file> paths fit.
+  char keysize[256];
+  char valuesize[256];
+  char keyorder[256];
   // int keysize;
   //  int valuesize;
-  char ia[32];
+  char ia[256];
+
+  int cdf_table;          // Inverse CDF table resolution, 0 = exact.
+  double cdf_table_error;
+  bool cdf_table_nearest;
+
+  uint64_t seed;  // Per-thread streams are derived from it, see rng_seed().
+  char dataset[256];  // --dataset file, "" if not given.
+  char replay[256];   // --replay trace, "" if not given.
+  char record[256];   // --record trace, "" if not given.
+  char ops[256];      // --ops mix, "" if not given.  See OpMix.h.
+  int rmw_retries;
+  char fill[256];     // --fill backend delay distribution, "" if not given.
+  char ttl[256];      // --ttl expiration distribution, "" if not given.
+  double speedup;
 
   // qps_per_connection
   // iadist
@@ -45,6 +60,29 @@ typedef struct {
   bool moderate;
   double getq_freq;
   int getq_size;
+
+  double interval;  // Measurement interval (seconds) for --slo.
+  double slo_nth;
+  double slo_target;
+  double slo_kp, slo_ki;
+
+  // This instance (0 = master, agents from 1) loads its share of records.
+  int load_instance, load_instances;
+
+  bool auto_warmup;
+  double ci;        // Target relative CI half-width, 0 for a fixed --time.
+  double ci_nth;
+
+  // --key_drift, --flash_crowd: see Popularity.h.
+  double drift_rate, drift_period;
+  double flash_start, flash_share, flash_duration;
+  uint64_t flash_keys;
+
+  bool ketama;  // Route by key over all servers, see Ketama.h.
+  bool fanout;  // Split multi-gets by server.
+  bool breakdown_conns;  // --breakdown=connection
+  int size_buckets;      // SIZE_NONE, SIZE_LOG2 or SIZE_SLAB.
+  bool timeline;         // --timeline, --working_set or --server_stats.
 } options_t;
 
 #endif // CONNECTIONOPTIONS_H
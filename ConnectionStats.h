@@ -4,6 +4,8 @@
 
 #include <algorithm>
 #include <inttypes.h>
+#include <math.h>
+#include <string.h>
 #include <vector>
 
 #ifdef USE_ADAPTIVE_SAMPLER
@@ -15,6 +17,8 @@
 #endif
 #include "AgentStats.h"
 #include "Operation.h"
+#include "Popularity.h"
+#include "SizeBuckets.h"
 
 using namespace std;
 
@@ -22,47 +26,173 @@ class ConnectionStats {
  public:
  static int details[];
  static int ndetails;
- ConnectionStats(bool _sampling = true) :
+ ConnectionStats(bool _sampling = true, int _size_mode = SIZE_NONE) :
 #ifdef USE_ADAPTIVE_SAMPLER
    get_sampler(100000), set_sampler(100000), op_sampler(100000),
+   phase_sampler(POP_PHASES, AdaptiveSampler<Operation>(100000)),
+   shard_sampler(100000), fanout_sampler(100000),
+   type_sampler(OP_TYPES, AdaptiveSampler<Operation>(100000)),
 #elif defined(USE_HISTOGRAM_SAMPLER)
    get_sampler(10000,1), set_sampler(10000,1), op_sampler(1000,1),
+   phase_sampler(POP_PHASES, HistogramSampler(10000,1)),
+   shard_sampler(10000,1), fanout_sampler(10000,1),
+   type_sampler(OP_TYPES, HistogramSampler(10000,1)),
 #else
    get_sampler(LOGSAMPLER_BINS), set_sampler(LOGSAMPLER_BINS), op_sampler(LOGSAMPLER_BINS),
+   phase_sampler(POP_PHASES, LogHistogramSampler(LOGSAMPLER_BINS)),
+   shard_sampler(LOGSAMPLER_BINS), fanout_sampler(LOGSAMPLER_BINS),
+   type_sampler(OP_TYPES, LogHistogramSampler(LOGSAMPLER_BINS)),
 #endif
-   rx_bytes(0), tx_bytes(0), gets(0), sets(0), start(0), stop(0), plotall(false),
-   get_misses(0), skips(0), sampling(_sampling) {
+   rx_bytes(0), tx_bytes(0), gets(0), sets(0), get_misses(0),
+   single_misses(0), others(0),
+   requests(0), rmw_attempts(0), rmw_conflicts(0), rmw_aborts(0), skips(0),
+   fanouts(0), fanout_parts(0), size_mode(_size_mode), start(0), stop(0),
+   slo_qps(0.0), slo_qps_ci(0.0), slo_intervals(0),
+   warmup_time(0.0), ci_precision(0.0), ci_converged(false),
+   loads(0), load_bytes(0), load_errors(0), load_time(0.0),
+   sampling(_sampling), plotall(false) {
+   memset(type_ops, 0, sizeof(type_ops));
+   memset(type_misses, 0, sizeof(type_misses));
+   memset(rmw_retries, 0, sizeof(rmw_retries));
    }
 
 #ifdef USE_ADAPTIVE_SAMPLER
   AdaptiveSampler<Operation> get_sampler;
   AdaptiveSampler<Operation> set_sampler;
   AdaptiveSampler<double> op_sampler;
+  vector<AdaptiveSampler<Operation> > phase_sampler;
+  AdaptiveSampler<Operation> shard_sampler;
+  AdaptiveSampler<double> fanout_sampler;
+  vector<AdaptiveSampler<Operation> > type_sampler;
 #elif defined(USE_HISTOGRAM_SAMPLER)
   HistogramSampler get_sampler;
   HistogramSampler set_sampler;
   HistogramSampler op_sampler;
+  vector<HistogramSampler> phase_sampler;
+  HistogramSampler shard_sampler;
+  HistogramSampler fanout_sampler;
+  vector<HistogramSampler> type_sampler;
 #else
   LogHistogramSampler get_sampler;
   LogHistogramSampler set_sampler;
   LogHistogramSampler op_sampler;
+  vector<LogHistogramSampler> phase_sampler;  // Gets by --flash_crowd phase.
+  LogHistogramSampler shard_sampler;   // --fanout parts, by server.
+  LogHistogramSampler fanout_sampler;  // --fanout requests, end to end.
+  vector<LogHistogramSampler> type_sampler;  // --ops, by Operation::type.
 #endif
 
   uint64_t rx_bytes, tx_bytes;
   uint64_t gets, sets, get_misses;
+  uint64_t single_misses;  // Of single-key gets, those --fill fills.
+  uint64_t others;  // --ops: all but gets and sets.
+  uint64_t requests;  // Answered, a multi-get once per key (--server_stats).
+  uint64_t type_ops[OP_TYPES], type_misses[OP_TYPES];
+  // --ops rmw: cas sent and met EXISTS, updates that ran out of
+  // --rmw_retries, and the retries of those that got through.
+  uint64_t rmw_attempts, rmw_conflicts, rmw_aborts;
+  uint64_t rmw_retries[RMW_RETRY_BINS];
   uint64_t skips;
+  uint64_t fanouts, fanout_parts;  // --fanout requests and their parts.
+
+  // --size_buckets: latency, ops and value bytes per value size bucket,
+  // allocated on the first sample.
+  int size_mode;
+#ifdef USE_ADAPTIVE_SAMPLER
+  vector<AdaptiveSampler<Operation> > size_sampler;
+#elif defined(USE_HISTOGRAM_SAMPLER)
+  vector<HistogramSampler> size_sampler;
+#else
+  vector<LogHistogramSampler> size_sampler;
+#endif
+  vector<uint64_t> size_ops, size_bytes;
 
   double start, stop;
 
+  // --slo: sustainable QPS and the half-width of its 95% CI.
+  double slo_qps, slo_qps_ci;
+  int slo_intervals;
+
+  // --auto_warmup / --ci: actual warmup length and precision reached.
+  double warmup_time;
+  double ci_precision;
+  bool ci_converged;
+
+  // Database loading: records, bytes sent, failed sets, seconds taken.
+  uint64_t loads, load_bytes, load_errors;
+  double load_time;
+
   bool sampling;
   bool plotall;
 
-  void log_get(Operation& op) { if (sampling) get_sampler.sample(op); gets++; }
-  void log_set(Operation& op) { if (sampling) set_sampler.sample(op); sets++; }
+  void log_get(Operation& op) {
+    if (sampling) {
+      get_sampler.sample(op);
+      if (op.phase >= 0) phase_sampler[op.phase].sample(op);
+      if (size_mode) log_size(op);
+    }
+    gets++;
+  }
+  void log_set(Operation& op) {
+    if (sampling) {
+      set_sampler.sample(op);
+      if (size_mode) log_size(op);
+    }
+    sets++;
+  }
+  // The reply to a get, or to a gat of an --ops mix.
+  void log_read(Operation& op) {
+    if (op.type == Operation::GET) log_get(op);
+    else log_other(op);
+  }
+  // Any op of an --ops mix but a get or a set.
+  void log_other(Operation& op) {
+    if (sampling) type_sampler[op.type].sample(op);
+    type_ops[op.type]++;
+    others++;
+  }
+  // A get that missed, or an op that found no key (or a different CAS
+  // unique, a non-numeric value...) to act on.
+  void log_miss(Operation& op) {
+    if (op.type != Operation::GET) {
+      type_misses[op.type]++;
+      return;
+    }
+    get_misses++;
+    if (!op.multi) single_misses++;
+  }
+  // The end of an --ops rmw update, stored or not: op spans all of it.
+  void log_rmw(Operation& op, bool stored, int retries) {
+    if (sampling) type_sampler[Operation::RMW].sample(op);
+    type_ops[Operation::RMW]++;
+    if (stored)
+      rmw_retries[retries < RMW_RETRY_BINS ? retries : RMW_RETRY_BINS - 1]++;
+  }
+  void log_size(Operation& op) {
+    if (op.value_size < 0) return;
+    if (size_sampler.empty()) init_size_buckets();
+    int b = SizeBuckets::bucket(size_mode, op.value_size, op.key_len);
+    size_sampler[b].sample(op);
+    size_ops[b]++;
+    size_bytes[b] += op.value_size;
+  }
+  void init_size_buckets() {
+#ifdef USE_ADAPTIVE_SAMPLER
+    size_sampler.assign(SIZE_BUCKETS, AdaptiveSampler<Operation>(100000));
+#elif defined(USE_HISTOGRAM_SAMPLER)
+    size_sampler.assign(SIZE_BUCKETS, HistogramSampler(10000,1));
+#else
+    size_sampler.assign(SIZE_BUCKETS, LogHistogramSampler(LOGSAMPLER_BINS));
+#endif
+    size_ops.assign(SIZE_BUCKETS, 0);
+    size_bytes.assign(SIZE_BUCKETS, 0);
+  }
   void log_op (double op)     { if (sampling)  op_sampler.sample(op); }
+  void log_shard(Operation& op) { if (sampling) shard_sampler.sample(op); }
+  void log_fanout(double t)   { if (sampling) fanout_sampler.sample(t * 1000000); }
 
   double get_qps() {
-    return (gets + sets) / (stop - start);
+    return (gets + sets + others) / (stop - start);
   }
   void dump() {
 	printf("gets=%ldk,sets=%ldk,duration=%.0f,",gets/1000,sets/1000,stop-start);
@@ -102,6 +232,20 @@ class ConnectionStats {
 	double ret_val=get_val>set_val?get_val:set_val;
 	return ret_val;
   }
+  // One sampler of the ops counted in gets + sets + others: an --ops
+  // rmw update is already counted by its parts.
+#ifdef USE_HISTOGRAM_SAMPLER
+  HistogramSampler all_ops() {
+    HistogramSampler all = get_sampler;
+#else
+  LogHistogramSampler all_ops() {
+    LogHistogramSampler all = get_sampler;
+#endif
+    all.accumulate(set_sampler);
+    for (int t = 0; t < OP_TYPES; t++)
+      if (t != Operation::RMW) all.accumulate(type_sampler[t]);
+    return all;
+  }
 #endif
 
   void accumulate(const ConnectionStats &cs) {
@@ -109,10 +253,28 @@ class ConnectionStats {
     for (auto i: cs.get_sampler.samples) get_sampler.sample(i); //log_get(i);
     for (auto i: cs.set_sampler.samples) set_sampler.sample(i); //log_set(i);
     for (auto i: cs.op_sampler.samples)  op_sampler.sample(i); //log_op(i);
+    for (int p = 0; p < POP_PHASES; p++)
+      for (auto i: cs.phase_sampler[p].samples) phase_sampler[p].sample(i);
+    for (auto i: cs.shard_sampler.samples) shard_sampler.sample(i);
+    for (auto i: cs.fanout_sampler.samples) fanout_sampler.sample(i);
+    for (int t = 0; t < OP_TYPES; t++)
+      for (auto i: cs.type_sampler[t].samples) type_sampler[t].sample(i);
+    if (cs.size_sampler.size() && size_sampler.empty()) init_size_buckets();
+    for (size_t b = 0; b < cs.size_sampler.size(); b++)
+      for (auto i: cs.size_sampler[b].samples) size_sampler[b].sample(i);
 #else
     get_sampler.accumulate(cs.get_sampler);
     set_sampler.accumulate(cs.set_sampler);
     op_sampler.accumulate(cs.op_sampler);
+    for (int p = 0; p < POP_PHASES; p++)
+      phase_sampler[p].accumulate(cs.phase_sampler[p]);
+    shard_sampler.accumulate(cs.shard_sampler);
+    fanout_sampler.accumulate(cs.fanout_sampler);
+    for (int t = 0; t < OP_TYPES; t++)
+      type_sampler[t].accumulate(cs.type_sampler[t]);
+    if (cs.size_sampler.size() && size_sampler.empty()) init_size_buckets();
+    for (size_t b = 0; b < cs.size_sampler.size(); b++)
+      size_sampler[b].accumulate(cs.size_sampler[b]);
 #endif
 
     rx_bytes += cs.rx_bytes;
@@ -120,7 +282,30 @@ class ConnectionStats {
     gets += cs.gets;
     sets += cs.sets;
     get_misses += cs.get_misses;
+    single_misses += cs.single_misses;
+    others += cs.others;
+    requests += cs.requests;
+    for (int t = 0; t < OP_TYPES; t++) {
+      type_ops[t] += cs.type_ops[t];
+      type_misses[t] += cs.type_misses[t];
+    }
+    rmw_attempts += cs.rmw_attempts;
+    rmw_conflicts += cs.rmw_conflicts;
+    rmw_aborts += cs.rmw_aborts;
+    for (int r = 0; r < RMW_RETRY_BINS; r++) rmw_retries[r] += cs.rmw_retries[r];
     skips += cs.skips;
+    fanouts += cs.fanouts;
+    fanout_parts += cs.fanout_parts;
+    for (size_t b = 0; b < cs.size_ops.size(); b++) {
+      size_ops[b] += cs.size_ops[b];
+      size_bytes[b] += cs.size_bytes[b];
+    }
+
+    // Threads (and agents) load concurrently.
+    loads += cs.loads;
+    load_bytes += cs.load_bytes;
+    load_errors += cs.load_errors;
+    if (cs.load_time > load_time) load_time = cs.load_time;
 
     start = cs.start;
     stop = cs.stop;
@@ -132,15 +317,67 @@ class ConnectionStats {
     gets += as.gets;
     sets += as.sets;
     get_misses += as.get_misses;
+    single_misses += as.single_misses;
+    others += as.others;
+    for (int t = 0; t < OP_TYPES; t++) {
+      type_ops[t] += as.type_ops[t];
+      type_misses[t] += as.type_misses[t];
+    }
+    rmw_attempts += as.rmw_attempts;
+    rmw_conflicts += as.rmw_conflicts;
+    rmw_aborts += as.rmw_aborts;
+    for (int r = 0; r < RMW_RETRY_BINS; r++) rmw_retries[r] += as.rmw_retries[r];
     skips += as.skips;
+    fanouts += as.fanouts;
+    fanout_parts += as.fanout_parts;
+
+    loads += as.loads;
+    load_bytes += as.load_bytes;
+    load_errors += as.load_errors;
+    if (as.load_time > load_time) load_time = as.load_time;
 
 #ifdef LOGSAMPLER_BINS
 	for (int i=0; i<LOGSAMPLER_BINS; i++) 
 		get_sampler.bins[i]	+=	as.get_bins[i];
 	get_sampler.sum 	+=	as.get_sum;
 	get_sampler.sum_sq	+=	as.get_sum_sq;
+	for (int p=0; p<POP_PHASES; p++) {
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			phase_sampler[p].bins[i]	+=	as.phase_bins[p][i];
+		phase_sampler[p].sum	+=	as.phase_sum[p];
+		phase_sampler[p].sum_sq	+=	as.phase_sum_sq[p];
+	}
+	for (int i=0; i<LOGSAMPLER_BINS; i++) {
+		shard_sampler.bins[i]	+=	as.shard_bins[i];
+		fanout_sampler.bins[i]	+=	as.fanout_bins[i];
+	}
+	shard_sampler.sum	+=	as.shard_sum;
+	shard_sampler.sum_sq	+=	as.shard_sum_sq;
+	fanout_sampler.sum	+=	as.fanout_sum;
+	fanout_sampler.sum_sq	+=	as.fanout_sum_sq;
+	for (int t=0; t<OP_TYPES; t++) {
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			type_sampler[t].bins[i]	+=	as.type_bins[t][i];
+		type_sampler[t].sum	+=	as.type_sum[t];
+		type_sampler[t].sum_sq	+=	as.type_sum_sq[t];
+	}
+	for (int b=0; b<SIZE_BUCKETS; b++) {
+		if (as.size_ops[b] == 0) continue;
+		if (size_sampler.empty()) init_size_buckets();
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			size_sampler[b].bins[i]	+=	as.size_bins[b][i];
+		size_sampler[b].sum	+=	as.size_sum[b];
+		size_sampler[b].sum_sq	+=	as.size_sum_sq[b];
+		size_ops[b]	+=	as.size_ops[b];
+		size_bytes[b]	+=	as.size_bytes[b];
+	}
 #endif
 
+    // Agents are independent, so their CI half-widths add in quadrature.
+    slo_qps += as.slo_qps;
+    slo_qps_ci = sqrt(slo_qps_ci * slo_qps_ci + as.slo_qps_ci * as.slo_qps_ci);
+    slo_intervals += as.slo_intervals;
+
     start = as.start;
     stop = as.stop;
   }
@@ -247,6 +484,22 @@ class ConnectionStats {
     if (plotit || plotall)
 	sampler.plot(tag,get_qps());
   }
+
+  // Half-width of the 95% confidence interval of each print_stats()
+  // column (std and min have none).
+  void print_ci(const char *tag, LogHistogramSampler &sampler) {
+	int i;
+	uint64_t n = sampler.total();
+
+    printf("%-7s %7.1f %7s %7s", tag,
+           n > 1 ? 1.96 * sampler.stddev() / sqrt((double) n) : 0.0, "-", "-");
+		for (i=0; i<ndetails; i++) {
+			double lo = 0.0, hi = 0.0;
+			if (n > 0) sampler.get_nth_ci(details[i], &lo, &hi);
+			printf(" %7.1f",(hi - lo) / 2);
+		}
+    printf("\n");
+  }
 #endif
 };
 
@@ -0,0 +1,124 @@
+/* -*- c++ -*- */
+#ifndef DATASET_H
+#define DATASET_H
+
+// A memory-mapped key/value dataset (--dataset).
+//
+// File layout (host byte order):
+//
+//   char     magic[8];          "MCPDSET1"
+//   uint64_t count;             number of records
+//   uint64_t flags;             DATASET_VALUES if records carry values
+//   uint64_t offsets[count];    file offset of each record
+//   records:
+//     uint16_t key_len;
+//     uint32_t value_len;
+//     char     key[key_len];
+//     char     value[value_len];  (only with DATASET_VALUES)
+//
+// Nothing is copied to the heap: keys and values are handed out as
+// pointers into the mapping, and the loader passes them to libevent by
+// reference.  Without DATASET_VALUES only the value lengths are taken
+// from the file and the bytes come from random_char.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "log.h"
+
+#define DATASET_MAGIC "MCPDSET1"
+#define DATASET_VALUES 0x1
+
+class Dataset {
+public:
+  Dataset(const char *_path) : path(_path) {
+    if ((fd = open(_path, O_RDONLY)) < 0)
+      DIE("--dataset: failed to open %s: %s", _path, strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st)) DIE("--dataset: fstat(%s) failed", _path);
+    length = st.st_size;
+
+    if (length < 24) DIE("--dataset: %s is too short", _path);
+
+    base = (const char *) mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) DIE("--dataset: mmap(%s) failed", _path);
+
+    if (memcmp(base, DATASET_MAGIC, 8))
+      DIE("--dataset: %s is not a dataset file", _path);
+
+    count = *(const uint64_t *) (base + 8);
+    flags = *(const uint64_t *) (base + 16);
+    offsets = (const uint64_t *) (base + 24);
+
+    if (count == 0) DIE("--dataset: %s is empty", _path);
+    if (count > (length - 24) / 8)
+      DIE("--dataset: %s is truncated", _path);
+
+    V("Mapped %" PRIu64 " records from %s", count, _path);
+  }
+
+  ~Dataset() {
+    munmap((void *) base, length);
+    close(fd);
+  }
+
+  uint64_t size() { return count; }
+  bool has_values() { return flags & DATASET_VALUES; }
+
+  const char *key(uint64_t i, int *key_len) {
+    const char *r = record(i);
+    *key_len = *(const uint16_t *) r;
+    return r + 6;
+  }
+
+  int value_length(uint64_t i) {
+    return *(const uint32_t *) (record(i) + 2);
+  }
+
+  // The value bytes, NULL if the file does not have them.
+  const char *value(uint64_t i) {
+    if (!has_values()) return NULL;
+    const char *r = record(i);
+    return r + 6 + *(const uint16_t *) r;
+  }
+
+  std::string path;
+
+private:
+  // The whole record, key and value included, must lie in the mapping.
+  const char *record(uint64_t i) {
+    uint64_t o = offsets[i % count];
+    if (o > length || length - o < 6)
+      DIE("--dataset: record %" PRIu64 " out of range", i);
+
+    const char *r = base + o;
+    uint32_t value_len = *(const uint32_t *) (r + 2);
+    if (value_len > INT_MAX)
+      DIE("--dataset: record %" PRIu64 " has a %" PRIu32 " byte value", i,
+          value_len);
+
+    uint64_t size = 6 + *(const uint16_t *) r;
+    if (has_values()) size += value_len;
+    if (length - o < size)
+      DIE("--dataset: record %" PRIu64 " out of range", i);
+    return r;
+  }
+
+  int fd;
+  const char *base;
+  uint64_t length;
+
+  uint64_t count, flags;
+  const uint64_t *offsets;
+};
+
+#endif // DATASET_H
@@ -2,6 +2,9 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <stdio.h>
+
 #include "Generator.h"
 
 Generator* createFacebookKey() { return new GEV(30.7984, 8.20449, 0.078688); }
@@ -31,10 +34,71 @@ Generator* createFacebookValue() {
 
 Generator* createFacebookIA() { return new GPareto(0, 16.0292, 0.154971); }
 
+// Load an empirical distribution from a text file of "<value> <cdf>"
+// lines, with values and cumulative probabilities in ascending order,
+// e.g. a histogram exported from production.  Blank lines and lines
+// starting with '#' are ignored.  The CDF is normalized to its last
+// entry, and each value is drawn with the probability of its step.
+Generator* createEmpirical(std::string path) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == NULL)
+    DIE("empirical: failed to open %s: %s", path.c_str(), strerror(errno));
+
+  std::vector< std::pair<double,double> > cdf;
+  char line[256];
+  int lineno = 0;
+
+  while (fgets(line, sizeof(line), f)) {
+    double v, c;
+    char *p = line;
+    lineno++;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') continue;
+    if (sscanf(p, "%lf %lf", &v, &c) != 2)
+      DIE("empirical: %s:%d: expected \"<value> <cdf>\"", path.c_str(), lineno);
+    if (cdf.size() && c < cdf.back().second)
+      DIE("empirical: %s:%d: CDF is not ascending", path.c_str(), lineno);
+    cdf.push_back(std::pair<double,double>(v, c));
+  }
+  fclose(f);
+
+  if (cdf.size() == 0 || cdf.back().second <= 0.0)
+    DIE("empirical: %s has no probability mass", path.c_str());
+
+  Discrete *d = new Discrete();
+  double last = 0.0, total = cdf.back().second;
+  for (size_t i = 0; i < cdf.size(); i++) {
+    d->add((cdf[i].second - last) / total, cdf[i].first);
+    last = cdf[i].second;
+  }
+
+  D("Empirical(%s, %d points)", path.c_str(), (int) cdf.size());
+  return d;
+}
+
+// Wrap g in a Tabulated inverse CDF if it is one of the smooth
+// distributions, or tabulate the default of a Discrete.  Anything else
+// is already cheap and is returned as is.
+Generator* createTabulated(Generator *g, int resolution, double max_error,
+                           bool nearest) {
+  if (g == NULL || resolution <= 0) return g;
+
+  Discrete *d = dynamic_cast<Discrete*>(g);
+  if (d) {
+    d->tabulate_default(resolution, max_error, nearest);
+    return d;
+  }
+
+  if (!g->smooth() || dynamic_cast<Tabulated*>(g)) return g;
+  return new Tabulated(g, resolution, max_error, nearest);
+}
+
 Generator* createGenerator(std::string str) {
   if (!strcmp(str.c_str(), "fb_key")) return createFacebookKey();
   else if (!strcmp(str.c_str(), "fb_value")) return createFacebookValue();
   else if (!strcmp(str.c_str(), "fb_ia")) return createFacebookIA();
+  else if (!strncasecmp(str.c_str(), "empirical:", 10))
+    return createEmpirical(str.substr(10));
 
   char *s_copy = new char[str.length() + 1];
   strcpy(s_copy, str.c_str());
@@ -77,6 +141,10 @@ Generator* createGenerator(std::string str) {
   else if (strcasestr(str.c_str(), "pareto")) return new GPareto(a1, a2, a3);
   else if (strcasestr(str.c_str(), "gev")) return new GEV(a1, a2, a3);
   else if (strcasestr(str.c_str(), "uniform")) return new Uniform(a1,a2);
+  else if (strcasestr(str.c_str(), "zipf"))
+    return new Zipfian(s1 ? a1 : 0.99);
+  else if (strcasestr(str.c_str(), "latest"))
+    return new Latest(s1 ? a1 : 0.99);
   else if (strcasestr(str.c_str(), "none")) return NULL;
 
   DIE("Unable to create Generator '%s'", str.c_str());
@@ -33,6 +33,9 @@
 // e[xponential]:lambda
 // p[areto]:scale,shape
 // g[ev]:loc,scale,shape
+// empirical:file             (a CDF, see createEmpirical())
+// zipf[ian]:theta           (key indices, see set_items())
+// latest:theta              (key indices, favours the latest insert)
 // fb_value, fb_key, fb_rate
 
 class Generator {
@@ -43,7 +46,20 @@ public:
   virtual ~Generator() {}
 
   virtual double generate(double U = -1.0) = 0;
+  // Fill out[0..n) with n draws.  Generators with a closed form
+  // override it with a plain loop over a block of uniforms, which the
+  // compiler can unroll (and vectorize where the math allows), instead
+  // of a virtual call per draw.
+  virtual void generate_batch(double *out, int n) {
+    for (int i = 0; i < n; i++) out[i] = generate();
+  }
   virtual void set_lambda(double lambda) {DIE("set_lambda() not implemented");}
+  // Size of the keyspace a key order generator draws indices from.
+  virtual void set_items(uint64_t) {}
+  // generate(U) is a smooth function of U and can be tabulated.
+  virtual bool smooth() { return false; }
+  // set_lambda() only rescales generate(U), by old lambda / new lambda.
+  virtual bool scales() { return false; }
 protected:
   std::string type;
 };
@@ -52,6 +68,9 @@ class Fixed : public Generator {
 public:
   Fixed(double _value = 1.0) : value(_value) { D("Fixed(%f)", value); }
   virtual double generate(double U = -1.0) { return value; }
+  virtual void generate_batch(double *out, int n) {
+    for (int i = 0; i < n; i++) out[i] = value;
+  }
   virtual void set_lambda(double lambda) {
     if (lambda > 0.0) value = 1.0 / lambda;
     else value = 0.0;
@@ -87,10 +106,15 @@ public:
   }
 
   virtual double generate(double U = -1.0) {
-    if (U < 0.0) U = drand48();
+    if (U < 0.0) U = rng_double();
     return scale * U + min;
   }
 
+  virtual void generate_batch(double *out, int n) {
+    rng_fill(out, n);
+    for (int i = 0; i < n; i++) out[i] = scale * out[i] + min;
+  }
+
   virtual void set_lambda(double lambda) {
     if (lambda > 0.0) scale = 2.0 / lambda;
     else scale = 0.0;
@@ -105,8 +129,8 @@ public:
   }
 
   virtual double generate(double U = -1.0) {
-    if (U < 0.0) U = drand48();
-    double V = U; // drand48();
+    if (U < 0.0) U = rng_double();
+    double V = U; // rng_double();
     double N = sqrt(-2 * log(U)) * cos(2 * M_PI * V);
     return mean + sd * N;
   }
@@ -116,6 +140,8 @@ public:
     else mean = 0.0;
   }
 
+  virtual bool smooth() { return true; }
+
 private:
   double mean, sd;
 };
@@ -128,12 +154,25 @@ public:
 
   virtual double generate(double U = -1.0) {
     if (lambda <= 0.0) return 0.0;
-    if (U < 0.0) U = drand48();
+    if (U < 0.0) U = rng_double();
     return -log(U) / lambda;
   }
 
+  virtual void generate_batch(double *out, int n) {
+    if (lambda <= 0.0) {
+      for (int i = 0; i < n; i++) out[i] = 0.0;
+      return;
+    }
+    rng_fill(out, n);
+    double r = 1.0 / lambda;
+    for (int i = 0; i < n; i++) out[i] = -log(out[i]) * r;
+  }
+
   virtual void set_lambda(double lambda) { this->lambda = lambda; }
 
+  virtual bool smooth() { return true; }
+  virtual bool scales() { return true; }
+
 private:
   double lambda;
 };
@@ -147,15 +186,24 @@ public:
   }
 
   virtual double generate(double U = -1.0) {
-    if (U < 0.0) U = drand48();
+    if (U < 0.0) U = rng_double();
     return loc + scale * (pow(U, -shape) - 1) / shape;
   }
 
+  virtual void generate_batch(double *out, int n) {
+    rng_fill(out, n);
+    double r = scale / shape;
+    for (int i = 0; i < n; i++) out[i] = loc + r * (pow(out[i], -shape) - 1);
+  }
+
   virtual void set_lambda(double lambda) {
     if (lambda <= 0.0) scale = 0.0;
     else scale = (1 - shape) / lambda - (1 - shape) * loc;
   }
 
+  virtual bool smooth() { return true; }
+  virtual bool scales() { return loc == 0.0; }
+
 private:
   double loc /* mu */;
   double scale /* sigma */, shape /* k */;
@@ -173,44 +221,314 @@ public:
     return loc + scale * (pow(e.generate(U), -shape) - 1) / shape;
   }
 
+  virtual bool smooth() { return true; }
+
 private:
   Exponential e;
   double loc /* mu */, scale /* sigma */, shape /* k */;
 };
 
+Generator* createTabulated(Generator *g, int resolution, double max_error,
+                          bool nearest = false);
+
+// A discrete distribution: value v with probability p for each add(p, v),
+// and a draw from def with the remaining probability.  The entries are
+// compiled into a Walker/Vose alias table on the first draw after an
+// add(), so sampling is O(1) whatever the number of entries.
 class Discrete : public Generator {
 public:
   ~Discrete() { delete def; }
-  Discrete(Generator* _def = NULL) : def(_def) {
+  Discrete(Generator* _def = NULL) : def(_def), scale(1.0), built(false) {
     if (def == NULL) def = new Fixed(0.0);
   }
 
   virtual double generate(double U = -1.0) {
     double Uc = U;
-    if (pv.size() > 0 && U < 0.0) U = drand48();
+    if (pv.size() == 0) return def->generate(Uc);
+    if (!built) build();
+    if (U < 0.0) U = rng_double();
 
-    double sum = 0;
-	std::vector< std::pair<double,double> >::iterator p; 
-    for (p= pv.begin(); p!= pv.end(); p++ )  {
-      sum += (*p).first;
-      if (U < sum) return (*p).second;
-    }
+    double x = U * prob.size();
+    size_t i = (size_t) x;
+    if (i >= prob.size()) i = prob.size() - 1;
+    if (x - i >= prob[i]) i = alias[i];
 
-    return def->generate(Uc);
+    if (i == pv.size()) return def->generate(Uc);
+    return scale * pv[i].second;
   }
 
   void add(double p, double v) {
     pv.push_back(std::pair<double,double>(p, v));
+    built = false;
+  }
+
+  // --cdf_table: tabulate the default, e.g. the GPareto tail of fb_value.
+  void tabulate_default(int resolution, double max_error, bool nearest) {
+    def = createTabulated(def, resolution, max_error, nearest);
+  }
+
+  // Scale the values to a mean of 1 / lambda.  Only for distributions
+  // without a default, such as empirical ones.
+  virtual void set_lambda(double lambda) {
+    double sum = 0.0, mean = 0.0;
+    for (size_t i = 0; i < pv.size(); i++) {
+      sum += pv[i].first;
+      mean += pv[i].first * pv[i].second;
+    }
+    if (sum < 1.0 - 1e-9 || mean <= 0.0)
+      DIE("set_lambda() not implemented");
+    scale = lambda > 0.0 ? sum / (lambda * mean) : 0.0;
   }
 
 private:
+  // Vose's alias method.  Slot pv.size() stands for the default.
+  void build() {
+    size_t n = pv.size() + 1;
+    double sum = 0.0;
+    for (size_t i = 0; i < pv.size(); i++) sum += pv[i].first;
+    double rest = sum < 1.0 ? 1.0 - sum : 0.0;
+    double total = sum + rest;
+
+    prob.assign(n, 0.0);
+    alias.assign(n, 0);
+
+    std::vector<double> w(n);
+    std::vector<size_t> small, large;
+    for (size_t i = 0; i < n; i++) {
+      w[i] = (i < pv.size() ? pv[i].first : rest) * n / total;
+      if (w[i] < 1.0) small.push_back(i);
+      else large.push_back(i);
+    }
+
+    while (small.size() && large.size()) {
+      size_t s = small.back(), l = large.back();
+      small.pop_back();
+      prob[s] = w[s];
+      alias[s] = l;
+      w[l] -= 1.0 - w[s];
+      if (w[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+
+    // Whatever is left is 1 up to rounding.
+    for (size_t i = 0; i < large.size(); i++) prob[large[i]] = 1.0;
+    for (size_t i = 0; i < small.size(); i++) prob[small[i]] = 1.0;
+
+    built = true;
+  }
+
   Generator *def;
   std::vector< std::pair<double,double> > pv;
+
+  double scale;
+  bool built;
+  std::vector<double> prob;
+  std::vector<size_t> alias;
+};
+
+// A tabulated inverse CDF (--cdf_table).  generate(U) of a smooth
+// generator is sampled at resolution + 1 evenly spaced U and linearly
+// interpolated, or with nearest, read from the value at the middle of
+// each interval, so a draw is a table lookup instead of pow() or log().
+// Every interval is checked against the exact generator (at its
+// midpoint, or at its ends for nearest) and those with a relative error
+// above max_error fall back to it; for the heavy-tailed distributions
+// these are the few intervals next to U = 0.
+class Tabulated : public Generator {
+public:
+  Tabulated(Generator *_g, int _resolution = 4096, double _max_error = 1e-3,
+            bool _nearest = false) :
+    g(_g), resolution(_resolution), max_error(_max_error),
+    nearest(_nearest), lambda(0.0) {
+    if (resolution < 1) DIE("Tabulated: resolution must be >= 1");
+    build();
+  }
+  ~Tabulated() { delete g; }
+
+  virtual double generate(double U = -1.0) {
+    if (U < 0.0) U = rng_double();
+    double x = U * resolution;
+    int i = (int) x;
+    if (i >= resolution) i = resolution - 1;
+    if (exact[i]) return g->generate(U);
+    if (nearest) return table[i];
+    return table[i] + (x - i) * (table[i + 1] - table[i]);
+  }
+
+  virtual void generate_batch(double *out, int n) {
+    rng_fill(out, n);
+    for (int i = 0; i < n; i++) out[i] = Tabulated::generate(out[i]);
+  }
+
+  // --slo calls this every interval, so a scale family just rescales
+  // the table; the relative errors, and so exact[], do not change.
+  virtual void set_lambda(double lambda) {
+    g->set_lambda(lambda);
+    if (g->scales() && this->lambda > 0.0 && lambda > 0.0) {
+      double r = this->lambda / lambda;
+      for (size_t i = 0; i < table.size(); i++) table[i] *= r;
+    } else {
+      build();
+    }
+    this->lambda = lambda;
+  }
+
+  virtual bool smooth() { return true; }
+  virtual bool scales() { return g->scales(); }
+
+  // Share of U that falls back to the exact generator.
+  double exact_fraction() {
+    int n = 0;
+    for (int i = 0; i < resolution; i++) n += exact[i];
+    return (double) n / resolution;
+  }
+
+private:
+  static bool close(double approx, double x, double max_error) {
+    if (!isfinite(approx) || !isfinite(x)) return false;
+    return fabs(approx - x) <= max_error * MAX(fabs(x), 1e-12);
+  }
+
+  void build() {
+    table.resize(resolution + 1);
+    exact.assign(resolution, 0);
+
+    if (nearest) {
+      for (int i = 0; i < resolution; i++)
+        table[i] = g->generate((i + 0.5) / resolution);
+      for (int i = 0; i < resolution; i++)
+        exact[i] = !close(table[i], g->generate((double) i / resolution),
+                          max_error) ||
+                   !close(table[i], g->generate((i + 1.0) / resolution),
+                          max_error);
+    } else {
+      for (int i = 0; i <= resolution; i++)
+        table[i] = g->generate((double) i / resolution);
+      for (int i = 0; i < resolution; i++)
+        exact[i] = !close((table[i] + table[i + 1]) / 2,
+                          g->generate((i + 0.5) / resolution), max_error);
+    }
+
+    D("Tabulated(resolution=%d, max_error=%g): %.3f%% exact", resolution,
+      max_error, 100 * exact_fraction());
+  }
+
+  Generator *g;
+  int resolution;
+  double max_error;
+  bool nearest;
+  double lambda;  // Of the table, 0 = not set by set_lambda().
+
+  std::vector<double> table;
+  std::vector<char> exact;  // Intervals that use g.
+};
+
+// Zipf distributed key index in [0, n): index i has probability
+// proportional to 1 / (i + 1)^theta.  Sampled in O(1) with the
+// rejection-inversion method of Hormann and Derflinger ("Rejection-
+// inversion to generate variates from monotone discrete distributions",
+// 1996), so there is no per-n setup table and theta may be any value
+// > 0, including 1.  Most U are accepted on the first try; retries draw
+// fresh uniforms.
+class Zipfian : public Generator {
+public:
+  Zipfian(double _theta = 0.99, uint64_t _n = 10000) : theta(_theta) {
+    if (theta <= 0.0) DIE("zipf: theta must be > 0");
+    set_items(_n);
+    D("Zipfian(theta=%f, n=%" PRIu64 ")", theta, n);
+  }
+
+  virtual double generate(double U = -1.0) {
+    if (U < 0.0) U = rng_double();
+    while (true) {
+      double u = h_n + U * (h_x1 - h_n);
+      double x = H_inverse(u);
+      double k = floor(x + 0.5);
+      if (k < 1.0) k = 1.0;
+      else if (k > n) k = n;
+      if (k - x <= s || u >= H(k + 0.5) - h(k)) return k - 1.0;
+      U = rng_double();
+    }
+  }
+
+  virtual void set_items(uint64_t _n) {
+    n = _n > 0 ? _n : 1;
+    h_x1 = H(1.5) - 1.0;
+    h_n = H(n + 0.5);
+    s = 2.0 - H_inverse(H(2.5) - h(2.0));
+  }
+
+private:
+  double h(double x) { return exp(-theta * log(x)); }
+
+  // Integral of h: (x^(1-theta) - 1) / (1 - theta), or log(x) at 1.
+  double H(double x) {
+    double lx = log(x);
+    return helper2((1.0 - theta) * lx) * lx;
+  }
+
+  double H_inverse(double x) {
+    double t = x * (1.0 - theta);
+    if (t < -1.0) t = -1.0;  // Rounding near the lower bound.
+    return exp(helper1(t) * x);
+  }
+
+  // log1p(x) / x and expm1(x) / x, continuous at 0.
+  static double helper1(double x) {
+    if (fabs(x) > 1e-8) return log1p(x) / x;
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+  static double helper2(double x) {
+    if (fabs(x) > 1e-8) return expm1(x) / x;
+    return 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+  }
+
+  double theta, n;
+  double h_x1, h_n, s;
+};
+
+// YCSB style "latest": new records are inserted at the head of the
+// keyspace, which wraps around at n and so overwrites the oldest, and
+// reads are Zipf distributed over the distance from the head.  The most
+// recently written keys are the most popular, and the hot set moves as
+// records are inserted.  The head is a count of inserts, which share()
+// can point at one counter for several generators (and threads).
+class Latest : public Generator {
+public:
+  Latest(double theta = 0.99, uint64_t _n = 10000) :
+    zipf(theta, _n), n(_n), own_head(0), head(&own_head) {}
+
+  virtual double generate(double U = -1.0) {
+    uint64_t d = (uint64_t) zipf.generate(U);
+    uint64_t h = __atomic_load_n(head, __ATOMIC_RELAXED) % n;
+    return (double) ((h + n - d % n) % n);
+  }
+
+  // Index of the next record to insert.
+  uint64_t insert() {
+    return __atomic_add_fetch(head, 1, __ATOMIC_RELAXED) % n;
+  }
+
+  virtual void set_items(uint64_t _n) {
+    n = _n > 0 ? _n : 1;
+    zipf.set_items(n);
+  }
+
+  void share(uint64_t *_head) { head = _head; }
+
+private:
+  Zipfian zipf;
+  uint64_t n;
+  uint64_t own_head;
+  uint64_t *head;
 };
 
 Generator* createGenerator(std::string str);
 Generator* createFacebookKey();
 Generator* createFacebookValue();
 Generator* createFacebookIA();
+Generator* createEmpirical(std::string path);
 
 #endif // GENERATOR_H
@@ -0,0 +1,212 @@
+/* -*- c++ -*- */
+#ifndef INTERVALSTATS_H
+#define INTERVALSTATS_H
+
+// Interval (time series) statistics.
+//
+// Every mcperf thread periodically snapshots the ConnectionStats of
+// its own connections and hands the difference since the previous
+// snapshot to the process-wide IntervalStats.  Once every thread has
+// reported interval k, the merged sample is complete and is handed to
+// whatever consumes the time series (e.g. the --slo controller).
+
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+
+#include <map>
+#include <vector>
+
+#include "ConnectionStats.h"
+#include "LogHistogramSampler.h"
+
+class IntervalSample {
+public:
+  IntervalSample() :
+    get_sampler(LOGSAMPLER_BINS), set_sampler(LOGSAMPLER_BINS),
+    gets(0), sets(0), get_misses(0), others(0), requests(0),
+    length(0.0) {}
+
+  LogHistogramSampler get_sampler;
+  LogHistogramSampler set_sampler;
+
+  uint64_t gets, sets, get_misses;
+  uint64_t others, requests;
+  double length;
+
+  // Add the running totals of a connection.  Unlike
+  // ConnectionStats::accumulate() this never copies saved samples.
+  void add(const ConnectionStats &cs) {
+    add_bins(get_sampler, cs.get_sampler, 1);
+    add_bins(set_sampler, cs.set_sampler, 1);
+    gets += cs.gets;
+    sets += cs.sets;
+    get_misses += cs.get_misses;
+    others += cs.others;
+    requests += cs.requests;
+  }
+
+  void accumulate(const IntervalSample &s) {
+    add_bins(get_sampler, s.get_sampler, 1);
+    add_bins(set_sampler, s.set_sampler, 1);
+    gets += s.gets;
+    sets += s.sets;
+    get_misses += s.get_misses;
+    others += s.others;
+    requests += s.requests;
+  }
+
+  void subtract(const IntervalSample &s) {
+    add_bins(get_sampler, s.get_sampler, -1);
+    add_bins(set_sampler, s.set_sampler, -1);
+    gets -= s.gets;
+    sets -= s.sets;
+    get_misses -= s.get_misses;
+    others -= s.others;
+    requests -= s.requests;
+  }
+
+  double get_qps() {
+    return length > 0.0 ? (gets + sets + others) / length : 0.0;
+  }
+
+  // Same definition as ConnectionStats::get_nth().
+  double get_nth(double nth) {
+    if (get_sampler.total() == 0 && set_sampler.total() == 0) return 0.0;
+    double get_val = get_sampler.total() > 0 ? get_sampler.get_nth(nth) : 0.0;
+    double set_val = set_sampler.total() > 0 ? set_sampler.get_nth(nth) : 0.0;
+    return get_val > set_val ? get_val : set_val;
+  }
+
+  // 95% CI of get_nth(), from whichever sampler it comes from.
+  void get_nth_ci(double nth, double *lo, double *hi) {
+    *lo = *hi = 0.0;
+    if (get_sampler.total() == 0 && set_sampler.total() == 0) return;
+    double get_val = get_sampler.total() > 0 ? get_sampler.get_nth(nth) : 0.0;
+    double set_val = set_sampler.total() > 0 ? set_sampler.get_nth(nth) : 0.0;
+    if (get_val > set_val) get_sampler.get_nth_ci(nth, lo, hi);
+    else set_sampler.get_nth_ci(nth, lo, hi);
+  }
+
+private:
+  static void add_bins(LogHistogramSampler &to, const LogHistogramSampler &from,
+                       int sign) {
+    for (size_t i = 0; i < to.bins.size(); i++) to.bins[i] += sign * from.bins[i];
+    to.sum += sign * from.sum;
+    to.sum_sq += sign * from.sum_sq;
+  }
+};
+
+// Mean of a series and the half-width of its 95% confidence interval,
+// using non-overlapping batch means so that correlated samples (queues
+// drain slowly) do not produce an overly optimistic interval.
+inline double student_t95(int dof) {
+  static const double t[] = { 0.0, 12.706, 4.303, 3.182, 2.776, 2.571,
+                              2.447, 2.365, 2.306, 2.262, 2.228, 2.201,
+                              2.179, 2.160, 2.145, 2.131, 2.120, 2.110,
+                              2.101, 2.093, 2.086, 2.080, 2.074, 2.069,
+                              2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+                              2.042 };
+  if (dof < 1) return 0.0;
+  if (dof <= 30) return t[dof];
+  return 1.96;
+}
+
+inline double batch_means(const std::vector<double> &x, double *half_width) {
+  size_t n = x.size();
+  *half_width = 0.0;
+  if (n == 0) return 0.0;
+
+  double mean = 0.0;
+  for (size_t i = 0; i < n; i++) mean += x[i];
+  mean /= n;
+
+  size_t b = (size_t) sqrt((double) n);  // Batch size.
+  if (b < 1) b = 1;
+  size_t k = n / b;                      // Number of batches.
+  if (k < 2) return mean;
+
+  double bmean = 0.0, var = 0.0;
+  std::vector<double> batches(k, 0.0);
+  for (size_t i = 0; i < k * b; i++) batches[i / b] += x[i] / b;
+  for (size_t i = 0; i < k; i++) bmean += batches[i] / k;
+  for (size_t i = 0; i < k; i++) var += pow(batches[i] - bmean, 2.0);
+  var /= k - 1;
+
+  *half_width = student_t95(k - 1) * sqrt(var / k);
+  return mean;
+}
+
+// MSER truncation point of a series: the number of leading samples
+// whose removal minimizes the standard error of the mean of the rest.
+// Only the first half of the series is searched; a result of n/2 means
+// the series is still trending and needs more samples.
+inline size_t mser(const std::vector<double> &x) {
+  size_t n = x.size();
+  if (n < 2) return 0;
+
+  // Suffix sums, so each candidate is O(1).
+  std::vector<double> s(n + 1, 0.0), sq(n + 1, 0.0);
+  for (size_t i = n; i-- > 0;) {
+    s[i] = s[i + 1] + x[i];
+    sq[i] = sq[i + 1] + x[i] * x[i];
+  }
+
+  size_t best = 0;
+  double best_stat = -1.0;
+  for (size_t d = 0; d <= n / 2; d++) {
+    double m = n - d;
+    double ss = sq[d] - s[d] * s[d] / m;  // Sum of squared deviations.
+    double stat = ss / (m * m);
+    if (best_stat < 0.0 || stat < best_stat) {
+      best_stat = stat;
+      best = d;
+    }
+  }
+
+  return best;
+}
+
+class IntervalStats {
+public:
+  IntervalStats(int _threads, double _length) :
+    length(_length), threads(_threads) {
+    pthread_mutex_init(&lock, NULL);
+  }
+  virtual ~IntervalStats() { pthread_mutex_destroy(&lock); }
+
+  // Called by each thread at the end of its k-th interval.
+  void add(int k, const IntervalSample &s) {
+    pthread_mutex_lock(&lock);
+
+    pending_t &p = pending[k];
+    p.sample.accumulate(s);
+    if (++p.reported == threads) {
+      p.sample.length = length;
+      interval_complete(k, p.sample);
+      pending.erase(k);
+    }
+
+    pthread_mutex_unlock(&lock);
+  }
+
+  double length;
+
+protected:
+  // Invoked with the lock held once all threads reported interval k.
+  virtual void interval_complete(int, IntervalSample &) {}
+
+  pthread_mutex_t lock;
+
+private:
+  struct pending_t {
+    pending_t() : reported(0) {}
+    IntervalSample sample;
+    int reported;
+  };
+
+  int threads;
+  std::map<int, pending_t> pending;
+};
+
+#endif // INTERVALSTATS_H
@@ -0,0 +1,99 @@
+/* -*- c++ -*- */
+#ifndef KETAMA_H
+#define KETAMA_H
+
+// Ketama consistent hashing (--ketama), compatible with libketama and
+// libmemcached's MEMCACHED_BEHAVIOR_KETAMA with equal weights.
+//
+// Every server "host:port" gets 160 points on a 32-bit continuum: the
+// four little-endian words of md5("host:port-k") for k in [0, 40).  A
+// key belongs to the server of the first point at or after the first
+// word of md5(key), wrapping around at the end.
+//
+// Lookups avoid the binary search: the points are kept in one sorted
+// array (and their servers in a parallel one), and a bucket table
+// indexed by the top bits of the hash gives the first point of each
+// bucket, so a lookup is one table read and a scan of a point or two.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "util.h"
+
+#define KETAMA_POINTS 40  // md5 digests per server, 4 points each.
+
+class Continuum {
+public:
+  Continuum(const std::vector<std::string> &servers) {
+    std::vector<std::pair<uint32_t, int> > p;
+    char buf[300];
+    unsigned char d[16];
+
+    for (size_t s = 0; s < servers.size(); s++)
+      for (int k = 0; k < KETAMA_POINTS; k++) {
+        int l = snprintf(buf, sizeof(buf), "%s-%d", servers[s].c_str(), k);
+        md5(buf, l, d);
+        for (int h = 0; h < 4; h++)
+          p.push_back(std::make_pair(word(d + h * 4), (int) s));
+      }
+    std::sort(p.begin(), p.end());
+
+    for (size_t i = 0; i < p.size(); i++) {
+      points.push_back(p[i].first);
+      owners.push_back(p[i].second);
+    }
+
+    // About two points per bucket.
+    shift = 32;
+    while (shift > 16 && (1ULL << (32 - shift)) < points.size() / 2) shift--;
+    buckets.resize((1 << (32 - shift)) + 1);
+    size_t i = 0;
+    for (uint64_t b = 0; b < buckets.size(); b++) {
+      while (i < points.size() && points[i] < (b << shift)) i++;
+      buckets[b] = i;
+    }
+
+    // Share of the hash space owned by each server.
+    shares.resize(servers.size(), 0.0);
+    for (size_t i = 0; i < points.size(); i++) {
+      uint32_t prev = i ? points[i - 1] : points.back();
+      shares[owners[i]] += (uint32_t) (points[i] - prev) / 4294967296.0;
+    }
+  }
+
+  static uint32_t hash(const char *key, int len) {
+    unsigned char d[16];
+    md5(key, len, d);
+    return word(d);
+  }
+
+  int server(uint32_t h) {
+    size_t i = buckets[h >> shift];
+    while (i < points.size() && points[i] < h) i++;
+    return i < points.size() ? owners[i] : owners[0];
+  }
+
+  int server(const char *key, int len) { return server(hash(key, len)); }
+
+  double share(int s) { return shares[s]; }
+
+private:
+  static uint32_t word(const unsigned char *d) {
+    return ((uint32_t) d[3] << 24) | ((uint32_t) d[2] << 16) |
+      ((uint32_t) d[1] << 8) | d[0];
+  }
+
+  std::vector<uint32_t> points;
+  std::vector<int> owners;
+  std::vector<uint32_t> buckets;
+  int shift;
+  std::vector<double> shares;
+};
+
+#endif // KETAMA_H
@@ -16,45 +16,89 @@
 #include <utility>
 
 #include <assert.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "Dataset.h"
 #include "log.h"
 #include "util.h"
 
 #define max_memcached_len 250
 
+// A key as its index and rendered length; the bytes are only produced
+// by KeyGenerator::render(), straight into the output buffer.
+typedef struct {
+  uint64_t index;
+  int len;
+} key_ref_t;
+
 class KeyGenerator {
 public:
-  KeyGenerator(Generator* _g, double _max = 10000) : g(_g), max(_max) {
-	mlen=floor(log10(max)) + 1;
+  KeyGenerator(Generator* _g, uint64_t _max = 10000, Dataset *_ds = NULL) :
+    g(_g), max(_max), ds(_ds) {
+	mlen=u64_digits(max);
   }
+  virtual ~KeyGenerator() {}
   int keysize(uint64_t h) {
     double U = (double) h / ULLONG_MAX;
     double G = g->generate(U);
     int keylen = MAX(round(G), mlen);
 	return keylen;
   }
-  virtual std::string generate(uint64_t ind) {
-    uint64_t h = fnv_64(ind);
-    int keylen = keysize(h);
-    char key[max_memcached_len];
-    snprintf(key, max_memcached_len, "%0*" PRIu64, keylen, ind);
-    return std::string(key);
+  // The index of the i-th key of a request sequence.
+  virtual uint64_t next_index(uint64_t i) { return i; }
+  // Length of the key of index ind: padded to keylen, or to its
+  // --keysize length if keylen is 0.
+  int key_length(uint64_t ind, int keylen = 0) {
+    if (ds) {
+      int l;
+      ds->key(ind, &l);
+      if (l > max_memcached_len) DIE("--dataset: key too long");
+      return l;
+    }
+    if (keylen == 0) keylen = keysize(fnv_64(ind));
+    keylen = MAX(keylen, u64_digits(ind));
+    return keylen < max_memcached_len ? keylen : max_memcached_len - 1;
+  }
+  key_ref_t ref(uint64_t ind, int keylen = 0) {
+    key_ref_t k = { ind, key_length(ind, keylen) };
+    return k;
+  }
+  // Write the len bytes of the key of index ind to out, no NUL.
+  void render(uint64_t ind, int len, char *out) {
+    if (ds) {
+      int l;
+      memcpy(out, ds->key(ind, &l), len);
+    } else {
+      format_u64(out, ind, len);
+    }
+  }
+  void render(const key_ref_t &k, char *out) { render(k.index, k.len, out); }
+  // Format the key of index ind into key[max_memcached_len], NUL
+  // terminated, padded as for key_length().
+  int format(uint64_t ind, char *key, int keylen = 0) {
+    int len = key_length(ind, keylen);
+    render(ind, len, key);
+    key[len] = '\0';
+    return len;
   }
 protected:
   Generator* g;
-  double max;
+  uint64_t max;
   int mlen;
+  Dataset *ds;  // With --dataset, keys come from the mapped index.
 };
 
 class DistKeyGenerator : public KeyGenerator {
 	//Instead of generating a specific index, each gen will get an index according to distribution provided
-	//The generator(kg) is assumed to be zipfian or pareto. This should not be used when seeding the data,
+	//The generator(kg) is assumed to be zipfian or pareto; zipf and latest draw indices in [0,max) directly.
+	//This should not be used when seeding the data,
 	//instead meant to enable the request order of indices to be zipfian.
 	//To that end, index parameter is ignored, and a generated index based on the distribution is used instead. 
 	//
@@ -63,96 +107,334 @@ class DistKeyGenerator : public KeyGenerator {
 	//	ks: distribtuion for key sizes
 	//	max: max number of keys
 public:
-  DistKeyGenerator(Generator* _ks, Generator* _kg, double _max = 10000) : KeyGenerator(_ks,_max), kg(_kg) {  }
-  std::string generate(uint64_t ind) {
-	double ridx = drand48();
-    ind = (uint64_t)kg->generate(ridx) % (uint64_t)max;
-    uint64_t h = fnv_64(ind);
-    int keylen = keysize(h);
-    snprintf(key, max_memcached_len, "%0*" PRIu64, keylen, ind);
-    return std::string(key);
+  DistKeyGenerator(Generator* _ks, Generator* _kg, uint64_t _max = 10000, Dataset *_ds = NULL) : KeyGenerator(_ks,_max,_ds), kg(_kg) {
+    kg->set_items(max);
+  }
+  uint64_t next_index(uint64_t) {
+    return (uint64_t)kg->generate(rng_double()) % max;
   }
 private:
   Generator* kg;
-  char key[max_memcached_len];
 };
 
 /*
-	Class: CachingKeyGenerator
-	A key generator that creates a cached pool of keys/requests
+	Class: KeyPool
+	A pool of request keys shared by every connection of the process.
 
 	Key generation can become a bottleneck if doing lots of small requests,
 	requiring large number of clients to saturate a server.
-	This class will build up a cache of requests and repeat sending those requests. Each client thread is going to have a different req seq, and the generator will regenerate some of the sequence every max_iterations over the data.
+	The pool is drawn from the key order and key size distributions, so its
+	memory scales with --keycache_capacity rather than with the number of
+	connections, and all of them share it in cache.  Entries are 16 byte
+	key_ref_t's in one contiguous array.
 
-	_capacity: size of the cache pool (default 10k)
-	max_iterations: how many times can the pool be reused before regenerating, defaults to 100. Set to 1 to always invoke regen.
-	regen_freedom: controls how much of the pool will be regenerated on each regen. Set to capacity to make each regen update the whole cache. Lower values will update fewer requests each reen cycle. Defaults to 1% of capacity.
+	Regeneration is double buffered: connections ask for it with
+	request_regen(), which never blocks, and a background thread copies
+	the active buffer to the shadow one, redraws regen_pct% of it, and
+	swaps it in.  Every swap starts a new epoch, and each cursor (see
+	CachingKeyGenerator) acknowledges it on its next key; the retired
+	buffer is only rewritten once all of them have, so no reader can be
+	copying a key out of it.  A request before that is held until the
+	last ack, or KEYPOOL_GRACE seconds after the swap: a cursor that has
+	gone quiet (a connection stalled at --depth, say) holds no key, and
+	one in the middle of fetch() is done long before.
+
+	ks, ko: key size and key order distributions; the pool owns them.
+	max: number of keys (--records)
+	capacity: size of the pool (default 10k)
+	regen_pct: share of the pool redrawn per regeneration (default 1%)
 */
-class CachingKeyGenerator {
-private:
-	std::vector< std::string > values;
-	std::vector< std::string > get_req;
-	uint64_t capacity,max;
-	KeyGenerator *kg;
-	void commonInit(int reuse, int pct_regen) {
+#define KEYPOOL_GRACE 0.1  // Longest wait (seconds) for the acks of a swap.
+
+class KeyPool {
+public:
+	KeyPool(Generator* ks, Generator* ko, uint64_t max, uint64_t capacity, Dataset *ds=NULL, int _regen_pct=1) :
+		keysize(ks), keyorder(ko), regen_pct(_regen_pct), epoch(0),
+		cursors(0), pending(0), deferred(false), swap_time(0.0),
+		requested(false),
+		stop(false), regens(0), regen_time(0.0), regen_max(0.0) {
 		if (capacity>max)
 			capacity=max;
-		values.resize(capacity);
-		get_req.resize(capacity);
-		step=1;
-		iterations=0;
-		max_iterations=reuse;
-		regen_freedom=capacity*pct_regen/100;
-		if(regen_freedom == 0) {
-			regen_freedom = 1;
+		if (capacity == 0)
+			capacity = 1;
+		if (ko != NULL)
+			kg=new DistKeyGenerator(ks, ko, max, ds);
+		else
+			kg=new KeyGenerator(ks, max, ds);
+		buffers[0].resize(capacity);
+		buffers[1].resize(capacity);
+		for (uint64_t i=0; i<capacity; i++)
+			buffers[0][i] = kg->ref(kg->next_index(i));
+		active = &buffers[0][0];
+
+		rng = rng_thread;  // The caller's stream, continued in the helper.
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+		if (pthread_create(&thread, NULL, regen_main, this))
+			DIE("pthread_create() failed");
+	}
+	// Every cursor must be gone by now.
+	~KeyPool() {
+		pthread_mutex_lock(&lock);
+		stop = true;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+		pthread_join(thread, NULL);
+		pthread_mutex_destroy(&lock);
+		pthread_cond_destroy(&cond);
+		delete kg;
+		delete keysize;
+		delete keyorder;
+	}
+	uint64_t size() { return buffers[0].size(); }
+	key_ref_t at(uint64_t i) {
+		return __atomic_load_n(&active, __ATOMIC_ACQUIRE)[i];
+	}
+	void render(const key_ref_t &k, char *out) { kg->render(k, out); }
+
+	// Ask the helper for a regeneration; a no-op if one is running.
+	void request_regen() {
+		if (pthread_mutex_trylock(&lock)) return;
+		requested = true;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+
+	// A cursor comes or goes; join() returns the current epoch.
+	uint64_t join() {
+		pthread_mutex_lock(&lock);
+		cursors++;
+		uint64_t e = epoch;
+		pthread_mutex_unlock(&lock);
+		return e;
+	}
+	void leave(uint64_t seen) {
+		pthread_mutex_lock(&lock);
+		cursors--;
+		if (seen != epoch) __atomic_sub_fetch(&pending, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&lock);
+	}
+	// Read before at(), so the key comes from that epoch's buffer or a
+	// later one; ack() it once, and every earlier key is done.
+	uint64_t current_epoch() {
+		return __atomic_load_n(&epoch, __ATOMIC_ACQUIRE);
+	}
+	void ack() {
+		if (__atomic_sub_fetch(&pending, 1, __ATOMIC_SEQ_CST) == 0 &&
+		    __atomic_load_n(&deferred, __ATOMIC_SEQ_CST)) {
+			pthread_mutex_lock(&lock);
+			requested = true;
+			pthread_cond_signal(&cond);
+			pthread_mutex_unlock(&lock);
 		}
 	}
-	
+
+	// Regenerations so far, and the seconds the helper spent on them.
+	void regen_stats(uint64_t &n, double &time, double &max) {
+		pthread_mutex_lock(&lock);
+		n = regens;
+		time = regen_time;
+		max = regen_max;
+		pthread_mutex_unlock(&lock);
+	}
+
+private:
+	static void *regen_main(void *arg) {
+		KeyPool *pool = (KeyPool *) arg;
+		rng_current = &pool->rng;
+		pthread_mutex_lock(&pool->lock);
+		while (1) {
+			while (!pool->requested && !pool->stop) {
+				if (!__atomic_load_n(&pool->deferred, __ATOMIC_SEQ_CST)) {
+					pthread_cond_wait(&pool->cond, &pool->lock);
+					continue;
+				}
+				// A deferred request goes ahead after the grace time.
+				struct timespec due;
+				double t = pool->swap_time + KEYPOOL_GRACE;
+				due.tv_sec = (time_t) t;
+				due.tv_nsec = (long) ((t - due.tv_sec) * 1e9);
+				if (pthread_cond_timedwait(&pool->cond, &pool->lock, &due) ==
+				    ETIMEDOUT)
+					pool->requested = true;
+			}
+			if (pool->stop) break;
+			pool->requested = false;
+			pthread_mutex_unlock(&pool->lock);
+			pool->regen();
+			pthread_mutex_lock(&pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	void regen() {
+		// Some cursor may still be reading the retired buffer: the
+		// last ack() asks again, or the helper once the grace is over.
+		__atomic_store_n(&deferred, true, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&pending, __ATOMIC_SEQ_CST) &&
+		    get_time() < swap_time + KEYPOOL_GRACE)
+			return;
+		__atomic_store_n(&deferred, false, __ATOMIC_SEQ_CST);
+
+		double start = get_time();
+		uint64_t capacity = size();
+		std::vector< key_ref_t > &shadow =
+			active == &buffers[0][0] ? buffers[1] : buffers[0];
+		memcpy(&shadow[0], active, capacity * sizeof(key_ref_t));
+
+		uint64_t regen_freedom = capacity * regen_pct / 100;
+		if (regen_freedom == 0) regen_freedom = 1;
+		uint64_t offset = rng_next() % (capacity / regen_freedom);
+		uint64_t stepper = rng_next() % (capacity / regen_freedom) + 1;
+		for (uint64_t i=offset; i<capacity; i+=stepper)
+			shadow[i] = kg->ref(kg->next_index(i));
+
+		pthread_mutex_lock(&lock);
+		__atomic_store_n(&pending, cursors, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&active, &shadow[0], __ATOMIC_RELEASE);
+		__atomic_store_n(&epoch, epoch + 1, __ATOMIC_RELEASE);
+		swap_time = get_time();
+
+		double t = swap_time - start;
+		regens++;
+		regen_time += t;
+		if (t > regen_max) regen_max = t;
+		pthread_mutex_unlock(&lock);
+	}
+
+	std::vector< key_ref_t > buffers[2];
+	key_ref_t *active;
+	KeyGenerator *kg;
+	Generator *keysize, *keyorder;
+	int regen_pct;
+
+	uint64_t epoch;    // Swaps so far.
+	uint64_t cursors;  // Joined cursors.
+	uint64_t pending;  // Cursors yet to ack the last swap.
+	bool deferred;     // A request waits for them.
+	double swap_time;  // get_time() of the last swap.
+
+	rng_t rng;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool requested, stop;
+
+	uint64_t regens;
+	double regen_time, regen_max;  // Seconds spent by the helper.
+};
+
+/*
+	Class: CachingKeyGenerator
+	A connection's cursor into the shared KeyPool.
+
+	Each connection walks the pool from its own random offset with its own
+	stride (coprime to the pool size, so a pass visits every entry once), and
+	picks a new offset and stride every max_iterations passes, so every
+	connection sends a different request sequence from the same pool.  That
+	is also when it asks the pool for a (background) regeneration.
+
+	Without a pool (--keycache_capacity=0) every key is drawn when it is
+	requested: from the key order distribution, or uniformly over all
+	max keys without one.  Nothing is stored per key, so max can be the
+	whole 64-bit space, at the price of a draw and a key size lookup per
+	request.
+
+	max_iterations: how many times can the pool be reused before regenerating, defaults to 100. Set to 1 to regenerate on every pass.
+*/
+class CachingKeyGenerator {
+private:
+	KeyPool *pool;
+	uint64_t capacity;
+	uint64_t next, step, remaining;
+
+	uint64_t seen;      // Pool epoch this cursor acked.
+
+	KeyGenerator *kg;   // Without a pool.
+	bool ordered;
+	uint64_t max;
+	key_ref_t last;
+
+	static uint64_t gcd(uint64_t a, uint64_t b) {
+		while (b) { uint64_t t = a % b; a = b; b = t; }
+		return a;
+	}
+	void reshuffle() {
+		next = rng_next() % capacity;
+		step = 1;
+		if (capacity > 2)
+			do step = rng_next() % (capacity - 1) + 1;
+			while (gcd(step, capacity) != 1);
+		remaining = capacity;
+	}
+	key_ref_t draw() {
+		return kg->ref(ordered ? kg->next_index(0) : rng_next() % max);
+	}
+	key_ref_t fetch(uint64_t i) {
+		uint64_t e = pool->current_epoch();
+		key_ref_t k = pool->at(i);
+		if (e != seen) {
+			seen = e;
+			pool->ack();
+		}
+		return k;
+	}
+
 public:
-	int next,step;
 	int iterations;
 	int max_iterations;
-	int regen_freedom;
 
 public:
-	CachingKeyGenerator(Generator* _ks, Generator* _kg, uint64_t _max=40000, int _capacity=10000, int reuse=100, int pct_regen=1) : capacity(_capacity), max(_max) {
-		commonInit(reuse,pct_regen);
-		if (_kg != NULL)
-			kg=new DistKeyGenerator(_ks, _kg, max);
+	CachingKeyGenerator(KeyPool *_pool, int reuse=100) :
+		pool(_pool), capacity(_pool->size()), seen(_pool->join()), kg(NULL),
+		ordered(false), max(0), iterations(0), max_iterations(reuse) {
+		reshuffle();
+	}
+	// Cache-free: ks and ko stay owned by the caller, ko may be NULL.
+	CachingKeyGenerator(Generator *ks, Generator *ko, uint64_t _max,
+	                    Dataset *ds=NULL) :
+		pool(NULL), capacity(0), seen(0), ordered(ko != NULL),
+		max(_max ? _max : 1),
+		iterations(0), max_iterations(0) {
+		if (ko != NULL)
+			kg=new DistKeyGenerator(ks, ko, max, ds);
 		else
-			kg=new KeyGenerator(_ks, max);
-		regen();
+			kg=new KeyGenerator(ks, max, ds);
+		last.index = 0;
+		last.len = 0;
 	}
 	~CachingKeyGenerator() {
+		if (pool) pool->leave(seen);
 		delete kg;
 	}
-	std::string generate(uint64_t ind) {
-		return values[ind];
+	// Any pooled key, e.g. for the extra keys of a multi-get.
+	key_ref_t at(uint64_t i) {
+		if (pool == NULL) return draw();
+		return fetch(i % capacity);
 	}
-	const char *current_get_req() {
-		return get_req[next].c_str();
+	uint64_t current_index() {
+		if (pool == NULL) return last.index;
+		return fetch(next).index;
 	}
-	const char *generate_next() {
+	key_ref_t generate_next() {
+		if (pool == NULL) return last = draw();
 		next+=step;
-		if (next >= capacity) {
-			next=0;
+		if (next >= capacity) next -= capacity;
+		if (--remaining == 0) {
+			remaining = capacity;
 			iterations++;
 			if (iterations > max_iterations) {
-				unsigned int regen_offset = rand() % (capacity / regen_freedom);
-				unsigned int regen_step = rand() % (capacity / regen_freedom) + 1;
-				regen(regen_step,regen_offset);
+				pool->request_regen();
+				reshuffle();
 				iterations=0;
 			}
 		}
-		return values[next].c_str();
+		return fetch(next);
 	}
-	void regen(unsigned int stepper=1, unsigned int offset=0) {
-		for (uint64_t i=offset ; i<capacity; i+=stepper) {
-			values[i] = kg->generate(i);
-			get_req[i] = std::string("get ") + values[i] + std::string("\r\n"); 
-		}
-		next=0;
+	void render(const key_ref_t &k, char *out) {
+		if (pool == NULL) kg->render(k, out);
+		else pool->render(k, out);
 	}
 };
 
@@ -8,6 +8,7 @@
 
 #include <vector>
 
+#include "log.h"
 #include "mcperf.h"
 #include "Operation.h"
 
@@ -30,10 +31,9 @@ public:
   double sum_sq;
 
   LogHistogramSampler() = delete;
-  LogHistogramSampler(int _bins) : sum(0.0), sum_sq(0.0) {
+  LogHistogramSampler(int _bins) :
+    bins(_bins + 1, 0), sum(0.0), sum_sq(0.0) {
     assert(_bins > 0);
-
-    bins.resize(_bins + 1, 0);
   }
 
   void sample(const Operation &op) {
@@ -75,16 +75,36 @@ public:
     DIE("Not implemented");
   }
 
+  // nth is a percentile, or per-mille above 100 and per-10k above 1000
+  // (i.e. 999 is p99.9), as in ConnectionStats::details.
+  static double nth_fraction(double nth) {
+    if (nth>1000.0) return nth/10000;
+    if (nth>100.0) return nth/1000;
+    return nth/100;
+  }
+
   double get_nth(double nth) {
-    uint64_t count = total();
+    return get_rank(total() * nth_fraction(nth));
+  }
+
+  // Distribution-free 95% confidence interval of the nth: the order
+  // statistics whose rank is within 1.96 standard deviations of the
+  // binomial count of samples below the nth.
+  void get_nth_ci(double nth, double *lo, double *hi) {
+    double count = total();
+    double p = nth_fraction(nth);
+    double d = 1.96 * sqrt(count * p * (1 - p));
+    double rlo = count * p - d, rhi = count * p + d;
+
+    if (rlo < 0) rlo = 0;
+    if (rhi > count - 1) rhi = count > 1 ? count - 1 : 0;
+    *lo = get_rank(rlo);
+    *hi = get_rank(rhi);
+  }
+
+  // Value of the sample of the given (fractional) rank.
+  double get_rank(double target) {
     uint64_t n = 0;
-    double target = count * nth/100;
-    if (nth>100.0) {
-	target = count * nth/1000;
-    }
-    if (nth>1000.0) {
-	target = count * nth/10000;
-    }
 
     for (size_t i = 0; i < bins.size(); i++) {
       n += bins[i];
@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+#ifndef OPMIX_H
+#define OPMIX_H
+
+// Weighted op mix (--ops), e.g. "get:80,set:10,delete:3,incr:5,touch:2".
+//
+// Weights are relative and need not add up to 100.  The mix is a
+// Discrete distribution over the op types, so a draw is one lookup in
+// its alias table however many ops the mix has.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Generator.h"
+#include "Operation.h"
+#include "log.h"
+#include "util.h"
+
+class OpMix {
+public:
+  OpMix(const char *spec) {
+    char buf[256], *save = NULL;
+    double weight[OP_TYPES] = { 0.0 };
+
+    strncpy(buf, spec, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (char *t = strtok_r(buf, ",", &save); t;
+         t = strtok_r(NULL, ",", &save)) {
+      char *colon = strchr(t, ':');
+      if (colon == NULL) DIE("--ops: expected op:weight, got \"%s\"", t);
+      *colon = '\0';
+
+      int type = find(t);
+      if (type < 0) DIE("--ops: unknown op \"%s\"", t);
+      char *end;
+      double w = strtod(colon + 1, &end);
+      if (*end || w < 0.0) DIE("--ops: bad weight for %s", t);
+      weight[type] += w;
+    }
+
+    double total = 0.0;
+    for (int t = 0; t < OP_TYPES; t++) total += weight[t];
+    if (total <= 0.0) DIE("--ops: no op has a weight");
+
+    // The default takes what rounding leaves: an op of the mix.
+    int first = 0;
+    while (weight[first] <= 0.0) first++;
+    table = new Discrete(new Fixed(first));
+    for (int t = 0; t < OP_TYPES; t++) {
+      shares[t] = weight[t] / total;
+      if (weight[t] > 0.0) table->add(shares[t], t);
+    }
+  }
+  ~OpMix() { delete table; }
+
+  int draw() { return (int) table->generate(); }
+
+  double share(int type) { return shares[type]; }
+
+  static int find(const char *name) {
+    for (int t = 0; t < OP_TYPES; t++)
+      if (t != Operation::FILL && !strcmp(name, Operation::type_name(t)))
+        return t;
+    return -1;
+  }
+
+private:
+  Discrete *table;  // Op type by its share.
+  double shares[OP_TYPES];
+};
+
+#endif // OPMIX_H
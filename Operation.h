@@ -2,24 +2,71 @@
 #ifndef OPERATION_H
 #define OPERATION_H
 
+#include <stdint.h>
+
 #include <string>
 
 using namespace std;
 
+class Connection;
+
+#define OP_TYPES 13  // Operation::type_enum values up to SASL.
+
+// A --fanout multi-get: its parts still outstanding and when it started.
+typedef struct {
+  double start_time;
+  int parts;
+} fanout_t;
+
+#define RMW_RETRY_BINS 16  // Retry counts reported, the last is "or more".
+
+// An --ops rmw: a gets, then a cas with the unique it returned, from
+// the top again if the cas meets EXISTS.
+typedef struct {
+  double start_time;  // That of the first gets.
+  uint64_t key;       // Index and length, see key_ref_t.
+  int key_len;
+  const char *value;  // What the cas writes.
+  int value_len;
+  uint64_t cas;       // Unique of the last gets.
+  int retries;
+} rmw_t;
+
 class Operation {
 public:
+  Operation() : multi(false), value_size(-1), key(0), key_len(0), phase(-1),
+    origin(NULL), fanout(NULL), cas(0), rmw(NULL) {}
+
   double start_time, end_time;
 
+  // The types before SASL are the ops of an --ops mix.
+  // RMW is not sent as such, it stands for a whole rmw_t update.  A
+  // FILL is the set of a --fill after a get miss.
   enum type_enum {
-    GET, SET, SASL
+    GET, SET, DELETE, INCR, DECR, APPEND, PREPEND, TOUCH, GAT, CAS, GETS,
+    RMW, FILL, SASL
   };
 
+  static const char *type_name(int t) {
+    static const char *names[] = { "get", "set", "delete", "incr", "decr",
+                                   "append", "prepend", "touch", "gat", "cas",
+                                   "gets", "rmw", "fill", "sasl" };
+    return names[t];
+  }
+
   type_enum type;
   int n_req;
   int n_recv;
+  bool multi;  // A multi-get.
+  int value_size;  // Sent, or received by a get hit; -1 if not known.
+  uint64_t key;    // Index and length of its key, see key_ref_t.
+  int key_len;
+  int phase;  // --flash_crowd phase it was issued in, -1 if none.
+  Connection *origin;  // --ketama: the connection that issued it.
+  fanout_t *fanout;    // The --fanout request it is a part of.
+  uint64_t cas;        // CAS unique of the reply, 0 if none.
+  rmw_t *rmw;          // The --ops rmw update it is a step of.
 
-  string key;
-  // string value;
 
   double time() const { return (end_time - start_time) * 1000000; }
 };
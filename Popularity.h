@@ -0,0 +1,75 @@
+/* -*- c++ -*- */
+#ifndef POPULARITY_H
+#define POPULARITY_H
+
+// Time-varying key popularity (--key_drift, --flash_crowd).
+//
+// The key order distribution ranks the keys; index() maps a drawn rank
+// to the key it stands for at time t (seconds since the start of the
+// run), so no per-key table is ever rebuilt:
+//
+//   drift:  index = (rank + offset) mod records, offset = RATE * t, or
+//           RATE * PERIOD * floor(t / PERIOD) to move the whole ranking
+//           in one step every PERIOD seconds.
+//   flash:  in [T, T + DURATION) a SHARE of the requests goes uniformly
+//           to a hot set of KEYS keys instead.  Its position is derived
+//           from --seed, so every thread and agent hits the same keys.
+//
+// Ops are tagged with the phase of the flash crowd they were issued in
+// (before, during, after) and the read latencies reported per phase.
+
+#include <math.h>
+#include <stdint.h>
+
+#include "ConnectionOptions.h"
+#include "util.h"
+
+#define POP_NONE -1  // No --flash_crowd, ops are not tagged.
+#define POP_PRE 0
+#define POP_FLASH 1
+#define POP_POST 2
+#define POP_PHASES 3
+
+class Popularity {
+public:
+  Popularity(const options_t &o) :
+    records(o.records ? o.records : 1), drift_rate(o.drift_rate),
+    drift_period(o.drift_period), flash_start(o.flash_start),
+    flash_share(o.flash_share), flash_end(o.flash_start + o.flash_duration),
+    flash_keys(o.flash_keys < records ? o.flash_keys : records) {
+    flash_base = fnv_64(o.seed) % records;
+  }
+
+  // Anything to do at all?
+  bool active() { return drift_rate > 0.0 || flash_share > 0.0; }
+
+  int phase(double t) {
+    if (flash_share <= 0.0) return POP_NONE;
+    if (t < flash_start) return POP_PRE;
+    return t < flash_end ? POP_FLASH : POP_POST;
+  }
+
+  static const char *phase_name(int p) {
+    static const char *names[POP_PHASES] = { "pre", "flash", "post" };
+    return names[p];
+  }
+
+  uint64_t index(uint64_t rank, double t) {
+    if (flash_share > 0.0 && t >= flash_start && t < flash_end &&
+        rng_double() < flash_share)
+      return (flash_base + rng_next() % flash_keys) % records;
+
+    if (drift_rate <= 0.0 || t <= 0.0) return rank;
+    if (drift_period > 0.0) t = floor(t / drift_period) * drift_period;
+    return (rank + (uint64_t) fmod(drift_rate * t, (double) records)) %
+      records;
+  }
+
+private:
+  uint64_t records;
+  double drift_rate, drift_period;
+  double flash_start, flash_share, flash_end;
+  uint64_t flash_keys, flash_base;
+};
+
+#endif // POPULARITY_H
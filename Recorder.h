@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+#ifndef RECORDER_H
+#define RECORDER_H
+
+// Request-stream recorder (--record).
+//
+// Each thread appends the ops it issues to its own buffer, which is
+// written out to FILE.part<thread> whenever it fills up.  At the end of
+// the run merge() combines the per-thread parts, ordered by time, into
+// a --replay trace (see Trace.h) and removes them.
+//
+// The trace has gets and sets only: the options that issue anything
+// else (--ops, --getq_freq) cannot be recorded, and the sets of --fill
+// follow from the misses of a replay instead.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Trace.h"
+#include "log.h"
+
+#define RECORDER_BUFFER 65536  // Records buffered per thread.
+
+class Recorder {
+public:
+  Recorder(const char *path, int thread) : count(0) {
+    char buf[300];
+    snprintf(buf, sizeof(buf), "%s.part%d", path, thread);
+    part = buf;
+    if ((file = fopen(buf, "w")) == NULL)
+      DIE("--record: failed to open %s: %s", buf, strerror(errno));
+    buffer.reserve(RECORDER_BUFFER);
+  }
+
+  ~Recorder() {
+    flush();
+    fclose(file);
+  }
+
+  // time is the intended issue time, relative to the start of the run.
+  void log(double time, uint64_t key, int op, int value_size, int conn) {
+    trace_record_t r;
+    r.time_ns = time > 0.0 ? (uint64_t) (time * 1e9) : 0;
+    r.key = key;
+    r.value_size = value_size;
+    r.conn = conn;
+    r.op = op;
+    r.key_len = 0;
+    buffer.push_back(r);
+    if (buffer.size() == RECORDER_BUFFER) flush();
+  }
+
+  void flush() {
+    if (buffer.size() &&
+        fwrite(&buffer[0], sizeof(trace_record_t), buffer.size(), file) !=
+        buffer.size())
+      DIE("--record: write to %s failed", part.c_str());
+    count += buffer.size();
+    buffer.clear();
+  }
+
+  // k-way merge of the parts of all threads into the trace out.
+  static void merge(const char *path, const char *out_path, int threads) {
+    std::vector<FILE*> parts;
+    std::vector<trace_record_t> head(threads);
+    std::priority_queue<std::pair<uint64_t, int>,
+                        std::vector<std::pair<uint64_t, int> >,
+                        std::greater<std::pair<uint64_t, int> > > q;
+    char buf[300];
+
+    for (int t = 0; t < threads; t++) {
+      snprintf(buf, sizeof(buf), "%s.part%d", path, t);
+      FILE *f = fopen(buf, "r");
+      if (f == NULL) DIE("--record: failed to open %s", buf);
+      setvbuf(f, NULL, _IOFBF, 1 << 20);
+      parts.push_back(f);
+      if (fread(&head[t], sizeof(trace_record_t), 1, f) == 1)
+        q.push(std::make_pair((uint64_t) head[t].time_ns, t));
+    }
+
+    FILE *out = fopen(out_path, "w");
+    if (out == NULL)
+      DIE("--record: failed to open %s: %s", out_path, strerror(errno));
+    setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+    uint64_t n = 0, flags = 0;
+    fwrite(TRACE_MAGIC, 8, 1, out);
+    fwrite(&n, 8, 1, out);  // Count, filled in below.
+    fwrite(&flags, 8, 1, out);
+
+    while (!q.empty()) {
+      int t = q.top().second;
+      q.pop();
+      if (fwrite(&head[t], sizeof(trace_record_t), 1, out) != 1)
+        DIE("--record: write to %s failed", out_path);
+      n++;
+      if (fread(&head[t], sizeof(trace_record_t), 1, parts[t]) == 1)
+        q.push(std::make_pair((uint64_t) head[t].time_ns, t));
+    }
+
+    fseek(out, 8, SEEK_SET);
+    fwrite(&n, 8, 1, out);
+    fclose(out);
+
+    for (int t = 0; t < threads; t++) {
+      fclose(parts[t]);
+      snprintf(buf, sizeof(buf), "%s.part%d", path, t);
+      unlink(buf);
+    }
+
+    V("Recorded %" PRIu64 " ops to %s", n, out_path);
+  }
+
+private:
+  FILE *file;
+  std::string part;
+  std::vector<trace_record_t> buffer;
+  uint64_t count;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,133 @@
+/* -*- c++ -*- */
+#ifndef RUNLENGTH_H
+#define RUNLENGTH_H
+
+// Adaptive run length.
+//
+// WarmupDetector (--auto_warmup) ends the warmup once neither the
+// interval QPS nor the interval tail latency is trending any more,
+// i.e. the MSER truncation point of both series lies in their first
+// half.
+//
+// RunLengthController (--ci) ends the measurement once the 95%
+// confidence interval of the requested percentile is narrower than
+// the target fraction of its value.  Two intervals are computed and
+// the wider one wins: the order-statistic CI of the merged histogram
+// (tight, but assumes independent samples) and the batch-means CI over
+// the per-interval percentiles (accounts for correlation over time).
+//
+// Both are only hints to the threads, which still stop at the fixed
+// --warmup / --time deadline at the latest.
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "IntervalStats.h"
+#include "log.h"
+
+#define WARMUP_MIN_INTERVALS 5
+#define CI_MIN_INTERVALS 10
+
+class WarmupDetector : public IntervalStats {
+public:
+  WarmupDetector(int threads, double length, double _nth) :
+    IntervalStats(threads, length), nth(_nth), done(false), elapsed(0.0) {}
+
+  bool warm() {
+    pthread_mutex_lock(&lock);
+    bool d = done;
+    pthread_mutex_unlock(&lock);
+    return d;
+  }
+
+  // Warmup needed to reach the steady state, 0 if it was not reached.
+  double warmup_time() {
+    pthread_mutex_lock(&lock);
+    double e = elapsed;
+    pthread_mutex_unlock(&lock);
+    return e;
+  }
+
+protected:
+  virtual void interval_complete(int, IntervalSample &s) {
+    qps.push_back(s.get_qps());
+    latency.push_back(s.get_nth(nth));
+
+    size_t n = qps.size();
+    if (done || n < WARMUP_MIN_INTERVALS) return;
+
+    size_t dq = mser(qps), dl = mser(latency);
+    D("warmup: t=%.1fs mser qps=%zu p%g=%zu (of %zu)",
+      n * length, dq, nth, dl, n);
+
+    if (dq < n / 2 && dl < n / 2) {
+      done = true;
+      elapsed = n * length;
+      V("Steady state after %.1fs of warmup.", elapsed);
+    }
+  }
+
+private:
+  double nth;
+  bool done;
+  double elapsed;
+  std::vector<double> qps, latency;
+};
+
+class RunLengthController : public IntervalStats {
+public:
+  RunLengthController(int threads, double length, double _nth,
+                      double _target) :
+    IntervalStats(threads, length), nth(_nth), target(_target),
+    half_width(0.0), done(false) {}
+
+  bool converged() {
+    pthread_mutex_lock(&lock);
+    bool d = done;
+    pthread_mutex_unlock(&lock);
+    return d;
+  }
+
+  // Relative half-width of the CI reached so far.
+  double precision() {
+    pthread_mutex_lock(&lock);
+    double p = half_width;
+    pthread_mutex_unlock(&lock);
+    return p;
+  }
+
+  double nth, target;
+
+protected:
+  virtual void interval_complete(int k, IntervalSample &s) {
+    total.accumulate(s);
+    if (s.get_nth(nth) > 0.0) latency.push_back(s.get_nth(nth));
+    if (done || latency.empty()) return;
+
+    double value = total.get_nth(nth);
+    double lo, hi, hw;
+    total.get_nth_ci(nth, &lo, &hi);
+    double mean = batch_means(latency, &hw);
+
+    half_width = (hi - lo) / 2 / value;
+    if (mean > 0.0 && hw / mean > half_width) half_width = hw / mean;
+
+    D("ci: t=%.1fs p%g = %.1fus +/- %.1f%%", (k + 1) * length, nth, value,
+      half_width * 100);
+
+    if (half_width <= target && latency.size() >= CI_MIN_INTERVALS) {
+      done = true;
+      V("p%g within +/- %.1f%% after %.1fs.", nth, half_width * 100,
+        (k + 1) * length);
+    }
+  }
+
+private:
+  IntervalSample total;
+  std::vector<double> latency;
+  double half_width;
+  bool done;
+};
+
+#endif // RUNLENGTH_H
@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+#ifndef SLOCONTROLLER_H
+#define SLOCONTROLLER_H
+
+// Closed-loop QPS controller for --slo N:X.
+//
+// A PI controller (velocity form) on the log of the latency error.
+// Every completed interval it compares the measured N-order statistic
+// with the target X and scales the aggregate QPS by
+//
+//   exp(kp * (e - e_prev) + ki * e),   e = log(X / measured)
+//
+// Working on the log keeps the loop gain independent of the absolute
+// QPS and latency.  e is clamped to +-1 and each step to [0.5x, 2x] so
+// a latency spike at saturation cannot collapse the rate in one step.
+// The QPS is not raised further while the client fails to deliver the
+// rate it was asked for (anti-windup): its share of the aggregate QPS,
+// i.e. that of its connections in lambda_denom.
+//
+// Every mcperf instance (master and agents) runs its own controller
+// on its own measurements; they all see the same server, so they
+// converge to the same operating point.
+
+#include <math.h>
+
+#include <vector>
+
+#include "IntervalStats.h"
+#include "log.h"
+
+class SLOController : public IntervalStats {
+public:
+  SLOController(int threads, double length, double _nth, double _target,
+                double _kp, double _ki, double _qps, double _share) :
+    IntervalStats(threads, length), nth(_nth), target(_target),
+    kp(_kp), ki(_ki), qps(_qps), share(_share), last_error(0.0) {}
+
+  // Aggregate QPS currently requested by the controller.
+  double get_target_qps() {
+    pthread_mutex_lock(&lock);
+    double q = qps;
+    pthread_mutex_unlock(&lock);
+    return q;
+  }
+
+  // Sustainable QPS: mean achieved QPS over the second half of the run
+  // (the controller has settled by then), with a 95% confidence interval.
+  double steady_state_qps(double *half_width, int *intervals) {
+    std::vector<double> tail(achieved.begin() + achieved.size() / 2,
+                             achieved.end());
+    *intervals = tail.size();
+    return batch_means(tail, half_width);
+  }
+
+  double nth, target;
+
+protected:
+  virtual void interval_complete(int k, IntervalSample &s) {
+    double measured = s.get_nth(nth);
+    double actual = s.get_qps();
+
+    achieved.push_back(actual);
+
+    if (measured <= 0.0) return;  // No samples, nothing to steer on.
+
+    double e = log(target / measured);
+    if (e > 1.0) e = 1.0;
+    if (e < -1.0) e = -1.0;
+
+    double step = exp(kp * (e - last_error) + ki * e);
+    if (step > 2.0) step = 2.0;
+    if (step < 0.5) step = 0.5;
+    last_error = e;
+
+    if (step > 1.0 && actual < qps * share * 0.9) step = 1.0;
+
+    I("slo: t=%6.1fs  p%g = %8.1fus  qps = %9.1f  target_qps = %9.1f -> %9.1f",
+      (k + 1) * length, nth, measured, actual, qps, qps * step);
+
+    qps *= step;
+  }
+
+private:
+  double kp, ki;
+  double qps;
+  double share;  // This instance's share of qps.
+  double last_error;
+  std::vector<double> achieved;
+};
+
+#endif // SLOCONTROLLER_H
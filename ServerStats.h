@@ -0,0 +1,474 @@
+/* -*- c++ -*- */
+#ifndef SERVERSTATS_H
+#define SERVERSTATS_H
+
+// Server-side stats over a side connection (--timeline, --working_set,
+// --server_stats).
+//
+// A StatsProbe is a plain blocking TCP connection to one server, apart
+// from the connections the load goes over, that sends "stats" (or
+// "stats slabs", "stats items") and parses the "STAT <name> <value>"
+// lines up to END.  It reconnects on the next query after any error,
+// and gives up on a reply after STATS_TIMEOUT seconds.
+//
+// The Timeline is an interval consumer like the --slo controller: it
+// merges the completed intervals into rows of --stats_interval, records
+// their QPS, latency and hit ratio, and wakes a probe thread of its
+// own, which polls the servers right away, so a slow server never
+// stalls the threads generating the load.  The server columns of a row
+// are the deltas since the previous poll; the probe thread prints each
+// row as soon as it has them, and print() the summary of the run.
+//
+// QPS agreement compares the requests answered to this mcperf in a row
+// with those the servers counted.  Below 100% the servers saw more than
+// this client got answers to (other clients, or requests it dropped);
+// above it, the client counted requests no server did.  The client
+// columns are this process's only, so with --agent, where the servers
+// also count the agents' requests, there is no agreement.
+
+#include <errno.h>
+#include <inttypes.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "IntervalStats.h"
+#include "log.h"
+#include "util.h"
+
+#define STATS_TIMEOUT 2
+
+typedef std::map<std::string, std::string> stats_map_t;
+
+class StatsProbe {
+public:
+  StatsProbe(const std::string &_server) : server(_server), fd(-1) {}
+  ~StatsProbe() { disconnect(); }
+
+  // Send cmd ("stats", "stats slabs", ...) and parse the reply into
+  // out.  False if the server cannot be reached or does not answer
+  // with STAT lines and END.
+  bool query(const char *cmd, stats_map_t &out) {
+    out.clear();
+    if (fd < 0 && !connect_server()) return false;
+
+    std::string req = std::string(cmd) + "\r\n";
+    if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t) req.size())
+      return fail("send");
+
+    std::string line;
+    while (read_line(line)) {
+      if (line == "END") return true;
+      if (line.compare(0, 5, "STAT ")) return fail(line.c_str());
+      size_t sp = line.find(' ', 5);
+      if (sp == std::string::npos) continue;
+      out[line.substr(5, sp - 5)] = line.substr(sp + 1);
+    }
+    return fail("recv");
+  }
+
+  // A stat as a number, 0 if the server does not have it.
+  static double get(const stats_map_t &m, const char *name) {
+    stats_map_t::const_iterator i = m.find(name);
+    return i == m.end() ? 0.0 : atof(i->second.c_str());
+  }
+
+  std::string server;  // "host:port"
+
+private:
+  bool connect_server() {
+    size_t colon = server.rfind(':');
+    std::string host = server.substr(0, colon);
+    std::string port = colon == std::string::npos ? "11211" :
+      server.substr(colon + 1);
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res))
+      return fail("getaddrinfo");
+
+    fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+      struct timeval tv = { STATS_TIMEOUT, 0 };
+      int one = 1;
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (connect(fd, res->ai_addr, res->ai_addrlen)) disconnect();
+    }
+    freeaddrinfo(res);
+
+    return fd >= 0 ? true : fail("connect");
+  }
+
+  bool read_line(std::string &line) {
+    size_t eol;
+    while ((eol = buf.find("\r\n")) == std::string::npos) {
+      char chunk[4096];
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) return false;
+      buf.append(chunk, n);
+    }
+    line = buf.substr(0, eol);
+    buf.erase(0, eol + 2);
+    return true;
+  }
+
+  bool fail(const char *what) {
+    D("stats %s: %s failed: %s", server.c_str(), what, strerror(errno));
+    disconnect();
+    return false;
+  }
+
+  void disconnect() {
+    if (fd >= 0) close(fd);
+    fd = -1;
+    buf.clear();
+  }
+
+  int fd;
+  std::string buf;
+};
+
+class Timeline : public IntervalStats {
+public:
+  Timeline(int threads, double length,
+           const std::vector<std::string> &servers, int _every, bool _detail,
+           bool _agents) :
+    IntervalStats(threads, length), every(_every), detail(_detail),
+    agents(_agents), merged(0), started(false), stop(false), last_time(0.0),
+    evictions(0.0), reclaimed(0.0), answered(0.0), served(0.0) {
+    for (size_t s = 0; s < servers.size(); s++)
+      probes.push_back(new StatsProbe(servers[s]));
+    last.resize(servers.size());
+    first_items.resize(servers.size());
+    last_items.resize(servers.size());
+    last_slabs.resize(servers.size());
+    pthread_cond_init(&wake, NULL);
+  }
+
+  ~Timeline() {
+    finish();
+    for (size_t s = 0; s < probes.size(); s++) delete probes[s];
+    pthread_cond_destroy(&wake);
+  }
+
+  // Baseline of the server counters, right before the measurement.
+  void begin() {
+    for (size_t s = 0; s < probes.size(); s++) {
+      if (!probes[s]->query("stats", last[s]) ||
+          (detail && (!probes[s]->query("stats items", first_items[s]) ||
+                      !probes[s]->query("stats slabs", last_slabs[s]))))
+        DIE("--timeline: no stats from %s", probes[s]->server.c_str());
+      last_items[s] = first_items[s];
+    }
+    last_time = get_time();
+    started = true;
+    print_header();
+    if (pthread_create(&thread, NULL, probe_main, this))
+      DIE("pthread_create() failed");
+  }
+
+  // Stop probing; the rows not sampled yet keep their client side.
+  void finish() {
+    if (!started) return;
+    pthread_mutex_lock(&lock);
+    stop = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    started = false;
+  }
+
+  void print() {
+    printf("\nServer evictions = %.0f, reclaimed = %.0f\n", evictions,
+           reclaimed);
+    if (detail) {
+      if (agents)
+        printf("QPS agreement = - (the servers count the agents' requests "
+               "too)\n");
+      else
+        printf("QPS agreement = %.1f%% (%.0f requests answered, %.0f counted "
+               "by the servers)\n", percent(answered, served), answered,
+               served);
+      print_slabs();
+    }
+  }
+
+protected:
+  // Rows span every intervals: merge them, then have the row polled.
+  virtual void interval_complete(int k, IntervalSample &s) {
+    acc.accumulate(s);
+    acc.length += s.length;
+    if (++merged < every) return;
+
+    row_t &r = rows[k / every];
+    r.qps = acc.get_qps();
+    r.p50 = acc.get_nth(50);
+    r.p99 = acc.get_nth(99);
+    r.gets = acc.gets;
+    r.misses = acc.get_misses;
+    r.ops = acc.requests;
+    acc = IntervalSample();
+    merged = 0;
+
+    queue.push_back(k / every);
+    pthread_cond_signal(&wake);
+  }
+
+private:
+  struct row_t {
+    row_t() : qps(0.0), p50(0.0), p99(0.0), gets(0), misses(0), ops(0.0),
+              probed(0), elapsed(0.0), items(0.0), bytes(0.0), maxbytes(0.0),
+              malloced(0.0), evictions(0.0), reclaimed(0.0), cmd_get(0.0),
+              get_hits(0.0), served(0.0), conn_yields(0.0), cpu(0.0),
+              oom(0.0) {}
+
+    double qps, p50, p99;
+    uint64_t gets, misses;
+    double ops;  // Requests answered, as the servers count them.
+
+    size_t probed;   // Servers that answered.
+    double elapsed;  // Since the previous poll.
+    double items, bytes, maxbytes, malloced;
+    double evictions, reclaimed, cmd_get, get_hits;  // Deltas from here.
+    double served, conn_yields, cpu, oom;
+  };
+
+  struct slab_t {
+    slab_t() : chunk(0.0), pages(0.0), items(0.0), used(0.0), total(0.0),
+               evicted(0.0), evicted_unfetched(0.0), expired_unfetched(0.0),
+               reclaimed(0.0), oom(0.0) {}
+
+    double chunk, pages, items, used, total;
+    double evicted, evicted_unfetched, expired_unfetched, reclaimed, oom;
+  };
+
+  static void *probe_main(void *arg) {
+    Timeline *t = (Timeline *) arg;
+    pthread_mutex_lock(&t->lock);
+    while (1) {
+      while (!t->stop && t->queue.empty())
+        pthread_cond_wait(&t->wake, &t->lock);
+      if (t->queue.empty()) break;
+
+      int k = t->queue.front();
+      t->queue.pop_front();
+
+      pthread_mutex_unlock(&t->lock);
+      row_t r = t->probe();
+      pthread_mutex_lock(&t->lock);
+
+      row_t &row = t->rows[k];
+      r.qps = row.qps;
+      r.p50 = row.p50;
+      r.p99 = row.p99;
+      r.gets = row.gets;
+      r.misses = row.misses;
+      r.ops = row.ops;
+      row = r;
+      t->evictions += r.evictions;
+      t->reclaimed += r.reclaimed;
+      if (r.probed == t->probes.size()) {
+        t->answered += r.ops;
+        t->served += r.served;
+      }
+      t->print_row(k, row);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+  }
+
+  void print_header() {
+    printf("\nTimeline (every %.1fs, client columns of this mcperf, server "
+           "columns summed over %zu server%s):\n", every * length,
+           probes.size(), probes.size() > 1 ? "s" : "");
+    printf("%-8s %10s %7s %7s %6s %8s %10s %6s %10s %10s", "#time", "QPS",
+           "p50", "p99", "hit%", "srv_hit%", "items", "mem%", "evictions",
+           "reclaimed");
+    if (detail)
+      printf(" %10s %7s %10s %8s %6s %7s %6s", "srv_QPS", "agree%", "get/s",
+             "yields", "cpu%", "slab%", "oom");
+    printf("\n");
+    fflush(stdout);
+  }
+
+  void print_row(int k, row_t &r) {
+    printf("%-8.1f %10.1f %7.1f %7.1f %6.1f ", (k + 1) * every * length,
+           r.qps, r.p50, r.p99,
+           r.gets ? (double) (r.gets - r.misses) / r.gets * 100 : 0.0);
+    if (r.probed < probes.size() || r.elapsed <= 0.0) {
+      printf("%8s %10s %6s %10s %10s", "-", "-", "-", "-", "-");
+      if (detail)
+        printf(" %10s %7s %10s %8s %6s %7s %6s", "-", "-", "-", "-", "-",
+               "-", "-");
+    } else {
+      printf("%8.1f %10.0f %6.1f %10.0f %10.0f",
+             r.cmd_get > 0 ? r.get_hits / r.cmd_get * 100 : 0.0, r.items,
+             percent(r.bytes, r.maxbytes), r.evictions, r.reclaimed);
+      if (detail) {
+        printf(" %10.1f", r.served / r.elapsed);
+        if (agents) printf(" %7s", "-");
+        else printf(" %7.1f", percent(r.ops, r.served));
+        printf(" %10.1f %8.0f %6.1f %7.1f %6.0f", r.cmd_get / r.elapsed,
+               r.conn_yields, r.cpu / r.elapsed * 100,
+               percent(r.malloced, r.maxbytes), r.oom);
+      }
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+
+  // Only the probe thread touches the probes and last* after begin().
+  row_t probe() {
+    // Counters of the requests a server served.  cas, append and prepend
+    // count as sets, a multi-get as a get per key, and a gat as a touch.
+    static const char *served_stats[] = {
+      "cmd_get", "cmd_set", "cmd_touch", "delete_hits", "delete_misses",
+      "incr_hits", "incr_misses", "decr_hits", "decr_misses", NULL };
+    row_t r;
+    stats_map_t now, items, slabs;
+
+    double t = get_time();
+    r.elapsed = t - last_time;
+    last_time = t;
+
+    for (size_t s = 0; s < probes.size(); s++) {
+      if (!probes[s]->query("stats", now)) continue;
+      if (detail && (!probes[s]->query("stats items", items) ||
+                     !probes[s]->query("stats slabs", slabs)))
+        continue;
+
+      r.probed++;
+      r.items += StatsProbe::get(now, "curr_items");
+      r.bytes += StatsProbe::get(now, "bytes");
+      r.maxbytes += StatsProbe::get(now, "limit_maxbytes");
+      r.evictions += delta(now, last[s], "evictions");
+      r.reclaimed += delta(now, last[s], "reclaimed");
+      r.cmd_get += delta(now, last[s], "cmd_get");
+      r.get_hits += delta(now, last[s], "get_hits");
+
+      if (detail) {
+        for (const char **c = served_stats; *c; c++)
+          r.served += delta(now, last[s], *c);
+        r.conn_yields += delta(now, last[s], "conn_yields");
+        r.cpu += delta(now, last[s], "rusage_user") +
+          delta(now, last[s], "rusage_system");
+        r.malloced += StatsProbe::get(slabs, "total_malloced");
+        r.oom += sum(items, "outofmemory") - sum(last_items[s], "outofmemory");
+        last_items[s] = items;
+        last_slabs[s] = slabs;
+      }
+      last[s] = now;
+    }
+    return r;
+  }
+
+  // Slab classes over the run, merged by class id across the servers.
+  void print_slabs() {
+    std::map<int, slab_t> classes;
+
+    for (size_t s = 0; s < probes.size(); s++) {
+      for (stats_map_t::iterator i = last_slabs[s].begin();
+           i != last_slabs[s].end(); i++) {
+        int id;
+        char field[64];
+        if (sscanf(i->first.c_str(), "%d:%63s", &id, field) != 2) continue;
+        slab_t &c = classes[id];
+        double v = atof(i->second.c_str());
+        if (!strcmp(field, "chunk_size")) c.chunk = v;
+        else if (!strcmp(field, "total_pages")) c.pages += v;
+        else if (!strcmp(field, "used_chunks")) c.used += v;
+        else if (!strcmp(field, "total_chunks")) c.total += v;
+      }
+
+      for (stats_map_t::iterator i = last_items[s].begin();
+           i != last_items[s].end(); i++) {
+        int id;
+        char field[64];
+        if (sscanf(i->first.c_str(), "items:%d:%63s", &id, field) != 2)
+          continue;
+        slab_t &c = classes[id];
+        double v = atof(i->second.c_str());
+        double d = v - StatsProbe::get(first_items[s], i->first.c_str());
+        if (!strcmp(field, "number")) c.items += v;
+        else if (!strcmp(field, "evicted")) c.evicted += d;
+        else if (!strcmp(field, "evicted_unfetched")) c.evicted_unfetched += d;
+        else if (!strcmp(field, "expired_unfetched")) c.expired_unfetched += d;
+        else if (!strcmp(field, "reclaimed")) c.reclaimed += d;
+        else if (!strcmp(field, "outofmemory")) c.oom += d;
+      }
+    }
+
+    printf("\nSlab classes (summed over the servers, counters over the "
+           "run):\n");
+    printf("%-6s %7s %6s %10s %6s %10s %10s %10s %10s %6s\n", "#class",
+           "chunk", "pages", "items", "used%", "evicted", "ev_unfetch",
+           "ex_unfetch", "reclaimed", "oom");
+    for (std::map<int, slab_t>::iterator i = classes.begin();
+         i != classes.end(); i++) {
+      slab_t &c = i->second;
+      if (c.pages == 0.0 && c.items == 0.0 && c.evicted == 0.0) continue;
+      printf("%-6d %7.0f %6.0f %10.0f %6.1f %10.0f %10.0f %10.0f %10.0f "
+             "%6.0f\n", i->first, c.chunk, c.pages, c.items,
+             percent(c.used, c.total), c.evicted, c.evicted_unfetched,
+             c.expired_unfetched, c.reclaimed, c.oom);
+    }
+  }
+
+  static double delta(const stats_map_t &now, const stats_map_t &then,
+                      const char *name) {
+    return StatsProbe::get(now, name) - StatsProbe::get(then, name);
+  }
+
+  // A field of "stats items" summed over the slab classes.
+  static double sum(const stats_map_t &items, const char *field) {
+    double total = 0.0;
+    size_t l = strlen(field);
+    for (stats_map_t::const_iterator i = items.begin(); i != items.end(); i++)
+      if (i->first.size() > l && i->first[i->first.size() - l - 1] == ':' &&
+          !i->first.compare(i->first.size() - l, l, field))
+        total += atof(i->second.c_str());
+    return total;
+  }
+
+  static double percent(double part, double whole) {
+    return whole > 0.0 ? part / whole * 100 : 0.0;
+  }
+
+  int every;    // Intervals per row.
+  bool detail;  // --server_stats
+  bool agents;  // --agent: the servers count more than this client.
+
+  std::vector<StatsProbe*> probes;
+  std::vector<stats_map_t> last;  // Previous answer of every server.
+  std::vector<stats_map_t> first_items, last_items, last_slabs;
+
+  IntervalSample acc;  // The intervals of the row being merged.
+  int merged;
+
+  pthread_t thread;
+  pthread_cond_t wake;
+  bool started, stop;
+  std::deque<int> queue;         // Rows waiting for their poll.
+  std::map<int, row_t> rows;
+  double last_time;              // Of the previous poll.
+  double evictions, reclaimed;   // Over the whole run.
+  double answered, served;       // Requests, over the rows all servers polled.
+};
+
+#endif // SERVERSTATS_H
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+#ifndef SIZEBUCKETS_H
+#define SIZEBUCKETS_H
+
+// Value size buckets of the latency breakdown (--size_buckets).
+//
+//   log2:  [2^b, 2^(b+1)) bytes of value.
+//   slab:  the slab class memcached would store the item in with its
+//          default settings (-n 48 -f 1.25, 512KB chunks, 64-bit with
+//          CAS): the item is a 48 byte header, the key and a NUL, the
+//          value and its CRLF, and the 8 byte CAS.  Larger items are
+//          chunked and share the last class.
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#define SIZE_NONE 0
+#define SIZE_LOG2 1
+#define SIZE_SLAB 2
+
+#define SIZE_BUCKETS 48
+
+#define SLAB_ITEM_HEADER 48
+#define SLAB_CHUNK_MAX (512 * 1024)
+
+class SizeBuckets {
+public:
+  static int bucket(int mode, int value_size, int key_len) {
+    if (mode == SIZE_LOG2) {
+      int b = value_size > 0 ? 31 - __builtin_clz(value_size) : 0;
+      return b;
+    }
+
+    const std::vector<int> &c = classes();
+    int item = SLAB_ITEM_HEADER + key_len + 1 + value_size + 2 + 8;
+    int b = std::lower_bound(c.begin(), c.end(), item) - c.begin();
+    return b < (int) c.size() ? b : c.size() - 1;
+  }
+
+  static int buckets(int mode) {
+    return mode == SIZE_SLAB ? classes().size() : 32;
+  }
+
+  static void label(int mode, int b, char *buf, size_t len) {
+    if (mode == SIZE_LOG2)
+      snprintf(buf, len, "%lld-%lld", b ? 1LL << b : 0LL, (2LL << b) - 1);
+    else
+      snprintf(buf, len, "slab%d:%d", b + 1, classes()[b]);
+  }
+
+  // Memory the item takes in the slab allocator (--working_set).
+  static int chunk(int value_size, int key_len) {
+    int item = SLAB_ITEM_HEADER + key_len + 1 + value_size + 2 + 8;
+    if (item > SLAB_CHUNK_MAX) return item;
+    return classes()[bucket(SIZE_SLAB, value_size, key_len)];
+  }
+
+private:
+  static const std::vector<int> &classes() {
+    static const std::vector<int> c = slab_classes();
+    return c;
+  }
+
+  // Chunk sizes of the slab classes, as in memcached's slabs_init().
+  static std::vector<int> slab_classes() {
+    std::vector<int> c;
+    double size = SLAB_ITEM_HEADER + 48;
+    while (size <= SLAB_CHUNK_MAX / 1.25 && c.size() < SIZE_BUCKETS - 1) {
+      int s = (int) size;
+      if (s % 8) s += 8 - s % 8;
+      c.push_back(s);
+      size = s * 1.25;
+    }
+    c.push_back(SLAB_CHUNK_MAX);
+    return c;
+  }
+};
+
+#endif // SIZEBUCKETS_H
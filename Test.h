@@ -0,0 +1,27 @@
+/* -*- c++ -*- */
+#ifndef TEST_H
+#define TEST_H
+
+// The checks of the Test*.cc programs (make check): a failed CHECK
+// prints its location and the program exits with 1 at the end.
+
+#include <stdio.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond, ...) do {                                   \
+    if (!(cond)) {                                              \
+      fprintf(stderr, "%s:%d: FAIL: ", __FILE__, __LINE__);     \
+      fprintf(stderr, __VA_ARGS__);                             \
+      fprintf(stderr, "\n");                                    \
+      test_failures++;                                          \
+    }                                                           \
+  } while (0)
+
+static inline int test_result(const char *name) {
+  if (test_failures) printf("%s: %d FAILED\n", name, test_failures);
+  else printf("%s: ok\n", name);
+  return test_failures ? 1 : 0;
+}
+
+#endif // TEST_H
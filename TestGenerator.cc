@@ -12,11 +12,67 @@
 #include "Generator.h"
 #include "util.h"
 
+#include <algorithm>
+#include <vector>
+
+// Goodness of fit of the --cdf_table approximation: a two-sample
+// Kolmogorov-Smirnov test of n tabulated draws against n exact ones,
+// the worst relative error at a few quantiles, and the cost per draw.
+static void goodness_of_fit(const char *dist, int resolution, int n) {
+  Generator *exact = createGenerator(dist);
+  Generator *table = createTabulated(createGenerator(dist), resolution, 1e-3);
+  std::vector<double> a(n), b(n);
+
+  double start = get_time();
+  for (int i = 0; i < n; i++) a[i] = exact->generate();
+  double t_exact = get_time() - start;
+
+  start = get_time();
+  for (int i = 0; i < n; i++) b[i] = table->generate();
+  double t_table = get_time() - start;
+
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+
+  double D = 0.0;
+  for (int i = 0, j = 0; i < n && j < n; ) {
+    double x = a[i] < b[j] ? a[i] : b[j];
+    while (i < n && a[i] <= x) i++;
+    while (j < n && b[j] <= x) j++;
+    D = MAX(D, fabs((double) (i - j) / n));
+  }
+  double critical = 1.628 * sqrt(2.0 / n);  // alpha = 0.01
+
+  double q[] = {0.5, 0.9, 0.99, 0.999};
+  double worst = 0.0;
+  for (int k = 0; k < 4; k++) {
+    double x = exact->generate(1.0 - q[k]), y = table->generate(1.0 - q[k]);
+    worst = MAX(worst, fabs(y - x) / MAX(fabs(x), 1e-12));
+  }
+
+  printf("%-32s D=%.5f (%s at 0.01)  quantile err=%.2e  %5.1f -> %5.1f ns\n",
+         dist, D, D < critical ? "pass" : "FAIL", worst, t_exact / n * 1e9,
+         t_table / n * 1e9);
+
+  delete exact;
+  delete table;
+}
+
 int main(int argc, char **argv) {
   //  double now = get_time();
   //  uint64_t x = fnv_64_buf(&now, sizeof(now));
 
-  srand48(0xdeadbeef);
+  rng_seed(0xdeadbeef, 0);
+
+  // ./TestGenerator gof [resolution]
+  if (argc > 1 && !strcmp(argv[1], "gof")) {
+    int resolution = argc > 2 ? atoi(argv[2]) : 4096;
+    const char *dists[] = {"exponential:1", "normal:100,10",
+                           "pareto:0.0,16.0292,0.154971",
+                           "gev:30.7984,8.20449,0.078688", "fb_value"};
+    for (int i = 0; i < 5; i++) goodness_of_fit(dists[i], resolution, 1000000);
+    return 0;
+  }
 
   /*
   Generator *n = createGenerator("n:1,1"); // new Normal(1, 1);
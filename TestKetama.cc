@@ -0,0 +1,81 @@
+// --ketama: md5 against the RFC 1321 test suite, and the continuum
+// against key -> server cases worked out with libketama's algorithm.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "Ketama.h"
+#include "Test.h"
+#include "util.h"
+
+static void test_md5() {
+  const char *vectors[][2] = {
+    { "", "d41d8cd98f00b204e9800998ecf8427e" },
+    { "a", "0cc175b9c0f1b6a831c399e269772661" },
+    { "abc", "900150983cd24fb0d6963f7d28e17f72" },
+    { "message digest", "f96b697d7cb7938d525a2f31aaf161d0" },
+    { "abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b" },
+    { "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+      "d174ab98d277d9f5a5611c2c9f419d9f" },
+    { "1234567890123456789012345678901234567890"
+      "1234567890123456789012345678901234567890",
+      "57edf4a22be3c955ac49da2e2107b67a" },
+  };
+
+  for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+    unsigned char d[16];
+    char hex[33];
+    md5(vectors[v][0], strlen(vectors[v][0]), d);
+    for (int i = 0; i < 16; i++) sprintf(hex + 2 * i, "%02x", d[i]);
+    CHECK(!strcmp(hex, vectors[v][1]), "md5(\"%s\") = %s, not %s",
+          vectors[v][0], hex, vectors[v][1]);
+  }
+}
+
+static void test_continuum() {
+  std::vector<std::string> servers;
+  servers.push_back("10.0.0.1:11211");
+  servers.push_back("10.0.0.2:11211");
+  servers.push_back("10.0.0.3:11211");
+  Continuum c(servers);
+
+  struct { const char *key; uint32_t hash; int server; } cases[] = {
+    { "foo", 3675831724U, 2 },
+    { "bar", 421377335U, 0 },
+    { "key0", 4060279841U, 2 },
+    { "key1", 2497097154U, 0 },
+    { "key2", 2854615160U, 2 },
+    { "key3", 2237083958U, 0 },
+    { "00000000000000000001", 2954129572U, 1 },
+    { "user:1234", 3891683073U, 0 },
+    { "", 3649838548U, 1 },
+    { "k10870", 4294348182U, 1 },  // Past the last point: wraps around.
+  };
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    int len = strlen(cases[i].key);
+    uint32_t h = Continuum::hash(cases[i].key, len);
+    CHECK(h == cases[i].hash, "hash(\"%s\") = %u, not %u", cases[i].key, h,
+          cases[i].hash);
+    int s = c.server(cases[i].key, len);
+    CHECK(s == cases[i].server, "server(\"%s\") = %d, not %d", cases[i].key,
+          s, cases[i].server);
+  }
+
+  double total = 0.0;
+  for (size_t s = 0; s < servers.size(); s++) {
+    CHECK(c.share(s) > 0.2 && c.share(s) < 0.5, "share(%zu) = %f", s,
+          c.share(s));
+    total += c.share(s);
+  }
+  CHECK(total > 0.999999 && total < 1.000001, "shares sum to %f", total);
+}
+
+int main() {
+  test_md5();
+  test_continuum();
+  return test_result("TestKetama");
+}
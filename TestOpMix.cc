@@ -0,0 +1,55 @@
+// --ops: the shares of a mix and how often each op is drawn.
+
+#include <math.h>
+#include <stdio.h>
+
+#include "OpMix.h"
+#include "Test.h"
+#include "util.h"
+
+#define DRAWS 1000000
+
+// Draw n ops from spec and check each type's frequency against want[].
+static void check_draws(const char *spec, const double want[OP_TYPES]) {
+  OpMix mix(spec);
+  int count[OP_TYPES] = { 0 };
+
+  for (int i = 0; i < DRAWS; i++) count[mix.draw()]++;
+
+  for (int t = 0; t < OP_TYPES; t++) {
+    CHECK(fabs(mix.share(t) - want[t]) < 1e-12, "%s: share(%s) = %f, not %f",
+          spec, Operation::type_name(t), mix.share(t), want[t]);
+    // Binomial: 5 sigma is well under 0.003 at these counts.
+    double f = (double) count[t] / DRAWS;
+    CHECK(fabs(f - want[t]) < 0.003, "%s: %s drawn %.4f, not %.4f", spec,
+          Operation::type_name(t), f, want[t]);
+  }
+}
+
+int main() {
+  rng_seed(1, 0);
+
+  double mix[OP_TYPES] = { 0.0 };
+  mix[Operation::GET] = 0.6;
+  mix[Operation::SET] = 0.2;
+  mix[Operation::DELETE] = 0.1;
+  mix[Operation::INCR] = 0.1;
+  check_draws("get:60,set:20,delete:10,incr:10", mix);
+
+  // Relative weights, and an op named twice adds up.
+  double relative[OP_TYPES] = { 0.0 };
+  relative[Operation::GETS] = 0.75;
+  relative[Operation::CAS] = 0.25;
+  check_draws("gets:1,cas:0.5,gets:2,cas:0.5", relative);
+
+  // A lone op, not get, takes every draw.
+  double lone[OP_TYPES] = { 0.0 };
+  lone[Operation::TOUCH] = 1.0;
+  check_draws("touch:3", lone);
+
+  CHECK(OpMix::find("rmw") == Operation::RMW, "find(rmw)");
+  CHECK(OpMix::find("fill") < 0, "fill is not an op of a mix");
+  CHECK(OpMix::find("bogus") < 0, "find(bogus)");
+
+  return test_result("TestOpMix");
+}
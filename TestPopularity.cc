@@ -0,0 +1,86 @@
+// --key_drift and --flash_crowd: the key a rank stands for over time,
+// and the phases of a flash crowd.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "Popularity.h"
+#include "Test.h"
+#include "util.h"
+
+#define RECORDS 1000
+
+static options_t base_options() {
+  options_t o;
+  memset(&o, 0, sizeof(o));
+  o.records = RECORDS;
+  o.seed = 42;
+  return o;
+}
+
+static void test_drift() {
+  options_t o = base_options();
+  o.drift_rate = 10.0;
+  Popularity p(o);
+
+  CHECK(p.active(), "drift is active");
+  CHECK(p.phase(5.0) == POP_NONE, "no phases without --flash_crowd");
+  CHECK(p.index(5, 0.0) == 5, "no drift at the start");
+  CHECK(p.index(5, 2.0) == 25, "index(5, 2s) = %" PRIu64, p.index(5, 2.0));
+  CHECK(p.index(990, 2.0) == 10, "index(990, 2s) = %" PRIu64,
+        p.index(990, 2.0));
+  CHECK(p.index(5, 100.5) == 10, "index(5, 100.5s) = %" PRIu64,
+        p.index(5, 100.5));
+
+  // In steps: the whole ranking moves every period.
+  o.drift_period = 1.0;
+  Popularity q(o);
+  CHECK(q.index(0, 0.9) == 0, "index(0, 0.9s) = %" PRIu64, q.index(0, 0.9));
+  CHECK(q.index(0, 1.5) == 10, "index(0, 1.5s) = %" PRIu64, q.index(0, 1.5));
+  CHECK(q.index(0, 2.0) == 20, "index(0, 2s) = %" PRIu64, q.index(0, 2.0));
+
+  options_t none = base_options();
+  Popularity r(none);
+  CHECK(!r.active(), "nothing to do by default");
+}
+
+static void test_flash() {
+  options_t o = base_options();
+  o.flash_start = 1.0;
+  o.flash_duration = 2.0;
+  o.flash_share = 0.3;
+  o.flash_keys = 10;
+  Popularity p(o);
+
+  CHECK(p.phase(0.5) == POP_PRE, "phase(0.5s) = %d", p.phase(0.5));
+  CHECK(p.phase(1.0) == POP_FLASH, "phase(1s) = %d", p.phase(1.0));
+  CHECK(p.phase(2.9) == POP_FLASH, "phase(2.9s) = %d", p.phase(2.9));
+  CHECK(p.phase(3.0) == POP_POST, "phase(3s) = %d", p.phase(3.0));
+
+  // The hot set is the same for every process with the same --seed.
+  uint64_t hot = fnv_64(o.seed) % RECORDS;
+  uint64_t rank = (hot + RECORDS / 2) % RECORDS;  // Away from the hot set.
+  int n = 100000, in_hot = 0, other = 0;
+  for (int i = 0; i < n; i++) {
+    uint64_t k = p.index(rank, 2.0);
+    if ((k + RECORDS - hot) % RECORDS < 10) in_hot++;
+    else if (k == rank) other++;
+  }
+  CHECK(in_hot + other == n, "%d draws neither hot nor the rank",
+        n - in_hot - other);
+  double share = (double) in_hot / n;
+  CHECK(share > 0.29 && share < 0.31, "hot share %.3f, not 0.3", share);
+
+  for (int i = 0; i < 1000; i++) {
+    CHECK(p.index(rank, 0.5) == rank, "hot before the crowd");
+    CHECK(p.index(rank, 3.5) == rank, "hot after the crowd");
+  }
+}
+
+int main() {
+  rng_seed(1, 0);
+  test_drift();
+  test_flash();
+  return test_result("TestPopularity");
+}
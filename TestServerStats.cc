@@ -0,0 +1,93 @@
+// --timeline, --server_stats: StatsProbe against a canned server that
+// answers a byte at a time, an error reply and a server that is down.
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "ServerStats.h"
+#include "Test.h"
+
+gengetopt_args_info args;  // The samplers look at --save.
+
+static const char *reply(const std::string &cmd) {
+  if (cmd == "stats")
+    return "STAT pid 42\r\nSTAT curr_items 1000\r\nSTAT version 1.6.9\r\n"
+      "STAT rusage_user 0.250000\r\nEND\r\n";
+  if (cmd == "stats slabs")
+    return "STAT 1:chunk_size 96\r\nSTAT active_slabs 1\r\nEND\r\n";
+  return "ERROR\r\n";
+}
+
+// Serves connections one after the other until the process exits.
+static void *server_main(void *arg) {
+  int listener = *(int *) arg;
+
+  while (1) {
+    int fd = accept(listener, NULL, NULL);
+    if (fd < 0) continue;
+
+    std::string buf;
+    char c;
+    while (recv(fd, &c, 1, 0) == 1) {
+      buf += c;
+      if (buf.size() < 2 || buf.compare(buf.size() - 2, 2, "\r\n")) continue;
+      const char *r = reply(buf.substr(0, buf.size() - 2));
+      for (const char *p = r; *p; p++) send(fd, p, 1, MSG_NOSIGNAL);
+      buf.clear();
+    }
+    close(fd);
+  }
+  return NULL;
+}
+
+int main() {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, (struct sockaddr *) &addr, sizeof(addr)) ||
+      listen(listener, 4) ||
+      getsockname(listener, (struct sockaddr *) &addr, &len)) {
+    perror("TestServerStats: listen");
+    return 1;
+  }
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, server_main, &listener);
+
+  char server[64];
+  snprintf(server, sizeof(server), "127.0.0.1:%d", ntohs(addr.sin_port));
+  StatsProbe probe(server);
+  stats_map_t m;
+
+  CHECK(probe.query("stats", m), "stats");
+  CHECK(m.size() == 4, "%zu stats, not 4", m.size());
+  CHECK(m["version"] == "1.6.9", "version = %s", m["version"].c_str());
+  CHECK(StatsProbe::get(m, "curr_items") == 1000.0, "curr_items = %f",
+        StatsProbe::get(m, "curr_items"));
+  CHECK(StatsProbe::get(m, "rusage_user") == 0.25, "rusage_user = %f",
+        StatsProbe::get(m, "rusage_user"));
+  CHECK(StatsProbe::get(m, "evictions") == 0.0, "a missing stat is 0");
+
+  CHECK(probe.query("stats slabs", m), "stats slabs on the same connection");
+  CHECK(StatsProbe::get(m, "1:chunk_size") == 96.0, "1:chunk_size = %f",
+        StatsProbe::get(m, "1:chunk_size"));
+
+  // Not a STAT line: fail, and reconnect on the next query.
+  CHECK(!probe.query("stats bogus", m), "an ERROR reply fails");
+  CHECK(m.empty(), "no stats from an ERROR reply");
+  CHECK(probe.query("stats", m) && m.size() == 4, "stats after reconnecting");
+
+  StatsProbe down("127.0.0.1:1");
+  CHECK(!down.query("stats", m), "a server that is down");
+
+  return test_result("TestServerStats");
+}
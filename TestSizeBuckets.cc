@@ -0,0 +1,68 @@
+// --size_buckets: the log2 and slab class buckets of a value size, and
+// the slab chunk --working_set costs an item at.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "SizeBuckets.h"
+#include "Test.h"
+
+static void test_log2() {
+  struct { int size, bucket; } cases[] = {
+    { 0, 0 }, { 1, 0 }, { 2, 1 }, { 3, 1 }, { 4, 2 }, { 1023, 9 },
+    { 1024, 10 }, { 1048576, 20 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    int b = SizeBuckets::bucket(SIZE_LOG2, cases[i].size, 10);
+    CHECK(b == cases[i].bucket, "log2 bucket(%d) = %d, not %d",
+          cases[i].size, b, cases[i].bucket);
+  }
+
+  char label[32];
+  SizeBuckets::label(SIZE_LOG2, 0, label, sizeof(label));
+  CHECK(!strcmp(label, "0-1"), "log2 label(0) = %s", label);
+  SizeBuckets::label(SIZE_LOG2, 10, label, sizeof(label));
+  CHECK(!strcmp(label, "1024-2047"), "log2 label(10) = %s", label);
+}
+
+static void test_slab() {
+  // memcached -n 48 -f 1.25: the first classes and the 512KB last one.
+  const int chunks[] = { 96, 120, 152, 192, 240, 304, 384, 480, 600, 752,
+                         944, 1184 };
+  char label[32], want[32];
+  for (int b = 0; b < (int) (sizeof(chunks) / sizeof(chunks[0])); b++) {
+    SizeBuckets::label(SIZE_SLAB, b, label, sizeof(label));
+    snprintf(want, sizeof(want), "slab%d:%d", b + 1, chunks[b]);
+    CHECK(!strcmp(label, want), "slab label(%d) = %s, not %s", b, label,
+          want);
+  }
+  int last = SizeBuckets::buckets(SIZE_SLAB) - 1;
+  SizeBuckets::label(SIZE_SLAB, last, label, sizeof(label));
+  snprintf(want, sizeof(want), "slab%d:%d", last + 1, SLAB_CHUNK_MAX);
+  CHECK(!strcmp(label, want), "last slab label = %s, not %s", label, want);
+
+  // A 10 byte key: 48 + 11 + value + 2 + 8 bytes of item.
+  struct { int size, bucket; } cases[] = {
+    { 0, 0 }, { 27, 0 }, { 28, 1 }, { 51, 1 }, { 52, 2 }, { 1000, 11 },
+    { 1 << 20, last },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    int b = SizeBuckets::bucket(SIZE_SLAB, cases[i].size, 10);
+    CHECK(b == cases[i].bucket, "slab bucket(%d) = %d, not %d",
+          cases[i].size, b, cases[i].bucket);
+  }
+
+  CHECK(SizeBuckets::chunk(27, 10) == 96, "chunk(27) = %d",
+        SizeBuckets::chunk(27, 10));
+  CHECK(SizeBuckets::chunk(28, 10) == 120, "chunk(28) = %d",
+        SizeBuckets::chunk(28, 10));
+  // Chunked items cost what they are.
+  CHECK(SizeBuckets::chunk(1 << 20, 10) == 48 + 11 + (1 << 20) + 2 + 8,
+        "chunk(1MB) = %d", SizeBuckets::chunk(1 << 20, 10));
+}
+
+int main() {
+  test_log2();
+  test_slab();
+  return test_result("TestSizeBuckets");
+}
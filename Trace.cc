@@ -0,0 +1,63 @@
+#include <event2/event.h>
+
+#include "Connection.h"
+#include "Trace.h"
+#include "log.h"
+#include "util.h"
+
+static void replay_timer_cb(evutil_socket_t, short, void *ptr) {
+  TraceReplayer *r = (TraceReplayer *) ptr;
+  r->timer_callback();
+}
+
+TraceReplayer::TraceReplayer(Trace *_trace, struct event_base *base,
+                             std::vector<Connection*> &_connections,
+                             int thread, double _speedup) :
+  issued(0), max_lag(0.0), trace(_trace), part(_trace->part(thread)),
+  connections(_connections), first_conn(_trace->first_conn(thread)),
+  speedup(_speedup), start_time(0.0), first_ns(0), next(0)
+{
+  timer = evtimer_new(base, replay_timer_cb, this);
+}
+
+TraceReplayer::~TraceReplayer() {
+  event_free(timer);
+}
+
+void TraceReplayer::start(double now) {
+  start_time = now;
+  next = 0;
+  // The time of the whole trace, so that all threads keep in step.
+  first_ns = trace->size() > 0 ? trace->record(0)->time_ns : 0;
+  timer_callback();
+}
+
+void TraceReplayer::timer_callback() {
+  double now = get_time();
+  struct timeval tv;
+  int budget = REPLAY_BATCH;
+
+  while (next < part.size()) {
+    const trace_record_t *r = trace->record(part[next]);
+    double due = start_time + (r->time_ns - first_ns) / 1e9 / speedup;
+
+    if (due > now) {
+      double_to_tv(due - now, &tv);
+      evtimer_add(timer, &tv);
+      return;
+    }
+
+    connections[trace->conn_of(r) - first_conn]->issue_replay(r, now);
+    if (now - due > max_lag) max_lag = now - due;
+    issued++;
+    budget--;
+    next++;
+
+    // Give the responses a chance before catching up further.
+    if (budget == 0) {
+      double_to_tv(0.0, &tv);
+      evtimer_add(timer, &tv);
+      return;
+    }
+  }
+}
@@ -0,0 +1,172 @@
+/* -*- c++ -*- */
+#ifndef TRACE_H
+#define TRACE_H
+
+// Binary request traces (--replay).
+//
+// File layout (host byte order):
+//
+//   char     magic[8];          "MCPTRCE2"
+//   uint64_t count;             number of records
+//   uint64_t flags;             reserved, 0
+//   trace_record_t records[count], sorted by time_ns
+//
+// The key of a record is a key index: with --dataset the index of a
+// dataset record, otherwise it is formatted like the generated keys
+// (zero-padded to key_len, or to the --keysize length of that index
+// if key_len is 0), so indices below --records hit the loaded data.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <event2/event.h>
+
+#include "log.h"
+#include "util.h"
+
+#define TRACE_MAGIC "MCPTRCE2"  // 1 had 16-bit connections.
+
+#define TRACE_GET 0
+#define TRACE_SET 1
+
+#define TRACE_ROUTE_BY_KEY 0xffffffff
+
+#define REPLAY_BATCH 256  // Ops issued per timer callback before yielding.
+
+typedef struct __attribute__ ((__packed__)) {
+  uint64_t time_ns;     // Offset from the start of the trace.
+  uint64_t key;         // Key index.
+  uint32_t value_size;  // For sets.
+  uint32_t conn;        // Connection, or TRACE_ROUTE_BY_KEY.
+  uint8_t op;           // TRACE_GET, TRACE_SET.
+  uint8_t key_len;      // 0 = as generated.
+} trace_record_t;
+
+class Trace {
+public:
+  Trace(const char *path) : total_conns(0) {
+    if ((fd = open(path, O_RDONLY)) < 0)
+      DIE("--replay: failed to open %s: %s", path, strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st)) DIE("--replay: fstat(%s) failed", path);
+    length = st.st_size;
+
+    if (length < 24) DIE("--replay: %s is too short", path);
+
+    base = (const char *) mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) DIE("--replay: mmap(%s) failed", path);
+    madvise((void *) base, length, MADV_SEQUENTIAL);
+
+    if (memcmp(base, TRACE_MAGIC, 8))
+      DIE("--replay: %s is not a trace file", path);
+
+    count = *(const uint64_t *) (base + 8);
+    records = (const trace_record_t *) (base + 24);
+
+    if (24 + count * sizeof(trace_record_t) > length)
+      DIE("--replay: %s is truncated", path);
+
+    V("Mapped %" PRIu64 " trace records from %s", count, path);
+  }
+
+  ~Trace() {
+    munmap((void *) base, length);
+    close(fd);
+  }
+
+  uint64_t size() { return count; }
+  const trace_record_t *record(uint64_t i) { return &records[i]; }
+
+  // Routes every record, once, to the thread that owns its connection.
+  // conns[t] is the number of connections of thread t; the connections
+  // of all threads are numbered in thread order.
+  void split(const std::vector<int> &conns) {
+    total_conns = 0;
+    firsts.clear();
+    for (size_t t = 0; t < conns.size(); t++) {
+      firsts.push_back(total_conns);
+      total_conns += conns[t];
+    }
+    firsts.push_back(total_conns);
+
+    parts.assign(conns.size(), std::vector<uint64_t>());
+    if (total_conns == 0) return;
+
+    for (uint64_t i = 0; i < count; i++) {
+      int c = conn_of(&records[i]);
+      int t = std::upper_bound(firsts.begin(), firsts.end(), c) -
+        firsts.begin() - 1;
+      parts[t].push_back(i);
+    }
+
+    V("Split %" PRIu64 " trace records over %d connections", count,
+      total_conns);
+  }
+
+  // The records of thread t, by index, in trace order.
+  const std::vector<uint64_t> &part(int t) { return parts[t]; }
+  int first_conn(int t) { return firsts[t]; }
+
+  // The global connection of a record: the recorded one or, for
+  // TRACE_ROUTE_BY_KEY, by the hash of the key.
+  int conn_of(const trace_record_t *r) {
+    uint64_t route = r->conn == TRACE_ROUTE_BY_KEY ? fnv_64(r->key) : r->conn;
+    return (int) (route % total_conns);
+  }
+
+private:
+  int fd;
+  const char *base;
+  uint64_t length;
+
+  uint64_t count;
+  const trace_record_t *records;
+
+  int total_conns;
+  std::vector<int> firsts;
+  std::vector<std::vector<uint64_t> > parts;
+};
+
+class Connection;
+
+// Replays a trace on the connections of one thread: the records that
+// Trace::split() routed to them, at start + time_ns / speedup.
+class TraceReplayer {
+public:
+  TraceReplayer(Trace *_trace, struct event_base *base,
+                std::vector<Connection*> &_connections, int thread,
+                double _speedup);
+  ~TraceReplayer();
+
+  void start(double now);
+  void timer_callback();
+
+  bool done() { return next >= part.size(); }
+
+  uint64_t issued;  // Ops issued by this thread.
+  double max_lag;   // Worst delay behind the trace, in seconds.
+
+private:
+  Trace *trace;
+  const std::vector<uint64_t> &part;
+  std::vector<Connection*> &connections;
+  struct event *timer;
+
+  int first_conn;
+  double speedup;
+
+  double start_time;
+  uint64_t first_ns;
+  uint64_t next;
+};
+
+#endif // TRACE_H
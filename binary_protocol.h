@@ -3,11 +3,21 @@
 
 #define CMD_GET  0x00
 #define CMD_SET  0x01
+#define CMD_DELETE 0x04
+#define CMD_INCR 0x05
+#define CMD_DECR 0x06
 #define CMD_MGET 0x09
 #define CMD_NOOP 0x0a
+#define CMD_APPEND 0x0e
+#define CMD_PREPEND 0x0f
+#define CMD_SETQ 0x11
+#define CMD_TOUCH 0x1c
+#define CMD_GAT 0x1d
 #define CMD_SASL 0x21
 
 #define RESP_OK 0x00
+#define RESP_NOT_FOUND 0x01
+#define RESP_EXISTS 0x02
 #define RESP_SASL_ERR 0x20
 
 typedef struct __attribute__ ((__packed__)) {
@@ -24,7 +34,7 @@ typedef struct __attribute__ ((__packed__)) {
 
   uint32_t body_len;
   uint32_t opaque;
-  uint64_t version;
+  uint64_t version;  // CAS unique.
 
   // Used for set only.
   uint64_t extras;
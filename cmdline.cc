@@ -47,7 +47,7 @@ const char *gengetopt_args_info_help[] = {
   "  -K, --keysize=STRING          Length of memcached keys (distribution).\n                                  (default=`30')",
   "      --keyorder=STRING         Selection of memcached keys to use\n                                  (distribution).  (default=`none')",
   "  -V, --valuesize=STRING        Length of memcached values (distribution).\n                                  (default=`200')",
-  "  -r, --records=INT             Number of memcached records to use.  If\n                                  multiple memcached servers are given, this\n                                  number is divided by the number of servers.\n                                  (default=`10000')",
+  "  -r, --records=LONG            Number of memcached records to use.  If\n                                  multiple memcached servers are given, this\n                                  number is divided by the number of servers.\n                                  (default=`10000')",
   "  -u, --update=FLOAT            Ratio of set:get commands.  (default=`0.0')",
   "\nAdvanced options:",
   "  -U, --username=STRING         Username to use for SASL authentication.",
@@ -72,10 +72,39 @@ const char *gengetopt_args_info_help[] = {
   "  -e, --trace                   To enable server tracing based on client\n                                  activity, will issue special\n                                  start_trace/stop_trace commands. Requires\n                                  memcached to support these commands.",
   "  -G, --getq_size=INT           Size of queue for multiget requests.\n                                  (default=`100')",
   "  -g, --getq_freq=FLOAT         Frequency of multiget requests, 0 for no\n                                  multi-get, 100 for only multi-get.\n                                  (default=`0.0')",
-  "      --keycache_capacity=INT   Cached key capacity. (default 10000)\n                                  (default=`10000')",
-  "      --keycache_reuse=INT      Number of times to reuse key cache before\n                                  generating new req sequence. (Default 100)\n                                  (default=`100')",
+  "      --keycache_capacity=INT   Cached key capacity, shared by all connections\n                                  of a process, 0 = draw every key when it is\n                                  requested. (default 10000)\n                                  (default=`10000')",
+  "      --keycache_reuse=INT      Number of times to reuse key cache before\n                                  starting a new req sequence. (Default 100)\n                                  (default=`100')",
   "      --keycache_regen=INT      When regenerating control number of requests to\n                                  regenerate. (Default 1%)  (default=`1')",
   "      --plot_all                Create plot/csv of latency histogram at each\n                                  step when using gnuplot and loghistogram\n                                  sampler",
+  "      --slo=N:X                 Closed-loop mode.  Continuously adjust the QPS\n                                  of every thread and agent to hold the N-order\n                                  statistic at Xus (i.e. --slo 99:1000 holds p99\n                                  at 1ms) and report the sustainable QPS.",
+  "      --slo_gains=Kp,Ki         Proportional and integral gains of the --slo\n                                  controller.  (default=`0.5,0.3')",
+  "      --interval=FLOAT          Length in seconds of the measurement interval\n                                  used by --slo, --auto_warmup and --ci.\n                                  (default=`1.0')",
+  "      --auto_warmup             Keep warming up until the interval QPS and\n                                  latency stop trending (MSER test), for at most\n                                  --warmup seconds (--time if not given).",
+  "      --ci=FLOAT                Stop measuring once the 95% confidence interval\n                                  of the --ci_nth latency is within this\n                                  fraction of its value (e.g. 0.05), for at most\n                                  --time seconds.",
+  "      --ci_nth=FLOAT            Latency percentile used by --ci.  (default=`99')",
+  "      --dataset=FILE            Load the records from a binary key/value dataset\n                                  file (see Dataset.h for the format) instead of\n                                  generating them, and draw the request keys\n                                  from it.  Overrides --records.",
+  "      --replay=FILE             Replay a binary request trace (see Trace.h for\n                                  the format) instead of generating requests,\n                                  for at most --time seconds.",
+  "      --speedup=FLOAT           Time-scale factor for --replay (2 replays the\n                                  trace twice as fast).  (default=`1.0')",
+  "      --record=FILE             Record the issued requests (intended time, op,\n                                  key, value size, connection) to a trace that\n                                  --replay can run.  Gets and sets only; --fill\n                                  sets are left out.  Later runs of --scan or\n                                  --search write FILE.1, FILE.2, ...",
+  "      --cdf_table=INT           Tabulate the inverse CDF of the continuous\n                                  distributions (normal, exponential, pareto,\n                                  gev, the fb_* tails) at INT points, 0 =\n                                  exact.  (default=`0')",
+  "      --cdf_table_error=FLOAT   Largest relative error of a --cdf_table\n                                  interval; intervals above it use the exact\n                                  distribution.  (default=`0.001')",
+  "      --cdf_table_nearest       Use the nearest --cdf_table entry instead of\n                                  interpolating.",
+  "      --seed=INT                Seed of the per-thread random number\n                                  generators.  Each thread (and agent) draws its\n                                  own stream, so runs are repeatable; 0 seeds\n                                  from the clock.  (default=`1')",
+  "      --key_drift=RATE[:PERIOD] Rotate the key popularity ranking by RATE keys\n                                  per second, or by RATE*PERIOD keys every\n                                  PERIOD seconds.",
+  "      --flash_crowd=T:SHARE:DURATION[:KEYS] At T seconds into the run, send SHARE (0-1) of\n                                  the requests to a hot set of KEYS keys\n                                  (default 10) for DURATION seconds, and report\n                                  the read latency before, during and after it.",
+  "      --ketama                  Route every op to the server owning its key on a\n                                  ketama consistent-hash continuum, over one\n                                  keyspace of --records keys, and report the\n                                  load and latency of each server.",
+  "      --fanout                  With --ketama, split every multi-get\n                                  (--getq_freq) into one part per server owning\n                                  some of its keys, sent in parallel, and report\n                                  the per-part and end-to-end latency.",
+  "      --breakdown=server|connection Report the load and latency of every server, or\n                                  of every connection too, and flag those whose\n                                  p99 is more than --outlier times the median\n                                  one's.",
+  "      --outlier=FLOAT           Outlier threshold of --breakdown, as a multiple\n                                  of the median p99.  (default=`2')",
+  "      --size_buckets=log2|slab  Also report the latency, QPS and bandwidth of\n                                  gets and sets by value size: power-of-two\n                                  buckets, or the slab class of the item with\n                                  memcached's default settings.",
+  "      --ops=get:W,set:W,...     Weighted op mix replacing --update, e.g.\n                                  get:80,set:10,delete:3,incr:5,touch:2. Ops:\n                                  get set delete incr decr append prepend touch\n                                  gat cas gets rmw (gets then cas, see\n                                  --rmw_retries). Gets are multi-gets as often\n                                  as --getq_freq says; incr and decr step\n                                  counters of their own, set to 0 before the\n                                  run, with --noload too.",
+  "      --rmw_retries=INT         Times an rmw of --ops goes back to its gets\n                                  after its cas meets EXISTS before it gives\n                                  up.  (default=`10')",
+  "      --fill=DIST               Cache-aside: after a get misses, wait a backend\n                                  delay drawn from DIST (microseconds, e.g.\n                                  fixed:1000 or exponential:0.001) and set the\n                                  key on the same connection.",
+  "      --ttl=DIST                Expiration time of every set, fill, cas, touch\n                                  and gat, drawn from DIST (seconds, e.g.\n                                  fixed:60 or exponential:0.01), clamped to\n                                  memcached's 30 days.  The loader's sets get\n                                  one too.",
+  "      --working_set=FACTOR      Size --records to FACTOR times the memory of the\n                                  servers (their limit_maxbytes over the mean\n                                  slab chunk of an item), so FACTOR > 1 keeps\n                                  them evicting.  Implies --timeline.",
+  "      --timeline                Report the hit ratio and the servers'\n                                  curr_items, memory use, evictions and reclaims\n                                  every --interval, the latter from a stats side\n                                  connection to every server.",
+  "      --server_stats            Add the servers' stats, stats slabs and stats\n                                  items to the --timeline: server QPS and its\n                                  agreement with this client's (not with\n                                  --agent), cmd_get rate, conn_yields and CPU\n                                  per row, and a per slab class summary of the\n                                  run.  Implies --timeline.",
+  "      --stats_interval=SECONDS  Length of a --timeline row, the period the\n                                  servers are polled at; rounded to a whole\n                                  number of --intervals, 0 = one\n                                  --interval.  (default=`0')",
   "\nAgent-mode options:",
   "  -A, --agentmode               Run client in agent mode.",
   "  -a, --agent=host              Enlist remote agent.",
@@ -86,13 +115,14 @@ const char *gengetopt_args_info_help[] = {
   "  -D, --measure_depth=INT       Set master client connection depth.",
   "  -m, --poll_freq=INT           Set frequency in seconds for agent protocol\n                                  recv polling.  (default=`1')",
   "  -M, --poll_max=INT            Set timeout for agent protocol recv polling. An\n                                  agent not responding within time limit will\n                                  be dropped.  (default=`120')",
-  "\nThe --measure_* options aid in taking latency measurements of the\nmemcached server without incurring significant client-side queuing\ndelay.  --measure_connections allows the master to override the\n--connections option.  --measure_depth allows the master to operate as\nan \"open-loop\" client while other agents continue as a regular\nclosed-loop clients.  --measure_qps lets you modulate the QPS the\nmaster queries at independent of other clients.  This theoretically\nnormalizes the baseline queuing delay you expect to see across a wide\nrange of --qps values.\n\nPredefined profiles to approximate some use cases:\n1. memcached for web serving benchmark : p95, 20ms, FB key/value/IA, >4000\nconnections to the device under test.\n2. memcached for applications backends : p99, 10ms, 32B key , 1000B value,\nuniform IA,  >1000 connections\n3. memcached for low latency (e.g. stock trading): p99.9, 32B key, 200B value,\nuniform IA, QPS rate set to 100000	\n4. P99.9, 1 msec. Key size = 32 bytes; value size has uniform distribution from\n100 bytes to 1k; \n\nSome options take a 'distribution' as an argument.\nDistributions are specified by <distribution>[:<param1>[,...]].\nParameters are not required.  The following distributions are supported:\n\n   [fixed:]<value>              Always generates <value>.\n   uniform:<max>                Uniform distribution between 0 and <max>.\n   normal:<mean>,<sd>           Normal distribution.\n   exponential:<lambda>         Exponential distribution.\n   pareto:<loc>,<scale>,<shape> Generalized Pareto distribution.\n   gev:<loc>,<scale>,<shape>    Generalized Extreme Value distribution.\n\n   To recreate the Facebook \"ETC\" request stream from [1], the\n   following hard-coded distributions are also provided:\n\n   fb_value   = a hard-coded discrete and GPareto PDF of value sizes\n   fb_key     = \"gev:30.7984,8.20449,0.078688\", key-size distribution\n   fb_ia      = \"pareto:0.0,16.0292,0.154971\", inter-arrival time dist.\n\n[1] Berk Atikoglu et al., Workload Analysis of a Large-Scale Key-Value Store,\n    SIGMETRICS 2012\n",
+  "\nThe --measure_* options aid in taking latency measurements of the\nmemcached server without incurring significant client-side queuing\ndelay.  --measure_connections allows the master to override the\n--connections option.  --measure_depth allows the master to operate as\nan \"open-loop\" client while other agents continue as a regular\nclosed-loop clients.  --measure_qps lets you modulate the QPS the\nmaster queries at independent of other clients.  This theoretically\nnormalizes the baseline queuing delay you expect to see across a wide\nrange of --qps values.\n\nPredefined profiles to approximate some use cases:\n1. memcached for web serving benchmark : p95, 20ms, FB key/value/IA, >4000\nconnections to the device under test.\n2. memcached for applications backends : p99, 10ms, 32B key , 1000B value,\nuniform IA,  >1000 connections\n3. memcached for low latency (e.g. stock trading): p99.9, 32B key, 200B value,\nuniform IA, QPS rate set to 100000	\n4. P99.9, 1 msec. Key size = 32 bytes; value size has uniform distribution from\n100 bytes to 1k; \n\nSome options take a 'distribution' as an argument.\nDistributions are specified by <distribution>[:<param1>[,...]].\nParameters are not required.  The following distributions are supported:\n\n   [fixed:]<value>              Always generates <value>.\n   uniform:<max>                Uniform distribution between 0 and <max>.\n   normal:<mean>,<sd>           Normal distribution.\n   exponential:<lambda>         Exponential distribution.\n   pareto:<loc>,<scale>,<shape> Generalized Pareto distribution.\n   gev:<loc>,<scale>,<shape>    Generalized Extreme Value distribution.\n   empirical:<file>             Values from a file of \"<value> <cdf>\" lines.\n   zipf:<theta>                 Zipf key order over --records (O(1) sampling).\n   latest:<theta>               Zipf over the distance from the latest insert;\n                                updates insert new keys at one head shared\n                                by the connections of a process, not by\n                                agents (--keyorder only).\n\n   To recreate the Facebook \"ETC\" request stream from [1], the\n   following hard-coded distributions are also provided:\n\n   fb_value   = a hard-coded discrete and GPareto PDF of value sizes\n   fb_key     = \"gev:30.7984,8.20449,0.078688\", key-size distribution\n   fb_ia      = \"pareto:0.0,16.0292,0.154971\", inter-arrival time dist.\n\n[1] Berk Atikoglu et al., Workload Analysis of a Large-Scale Key-Value Store,\n    SIGMETRICS 2012\n",
     0
 };
 
 typedef enum {ARG_NO
   , ARG_STRING
   , ARG_INT
+  , ARG_LONG
   , ARG_FLOAT
 } cmdline_parser_arg_type;
 
@@ -178,6 +208,35 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->keycache_reuse_given = 0 ;
   args_info->keycache_regen_given = 0 ;
   args_info->plot_all_given = 0 ;
+  args_info->slo_given = 0 ;
+  args_info->slo_gains_given = 0 ;
+  args_info->interval_given = 0 ;
+  args_info->auto_warmup_given = 0 ;
+  args_info->ci_given = 0 ;
+  args_info->ci_nth_given = 0 ;
+  args_info->dataset_given = 0 ;
+  args_info->replay_given = 0 ;
+  args_info->speedup_given = 0 ;
+  args_info->record_given = 0 ;
+  args_info->cdf_table_given = 0 ;
+  args_info->cdf_table_error_given = 0 ;
+  args_info->cdf_table_nearest_given = 0 ;
+  args_info->seed_given = 0 ;
+  args_info->key_drift_given = 0 ;
+  args_info->flash_crowd_given = 0 ;
+  args_info->ketama_given = 0 ;
+  args_info->fanout_given = 0 ;
+  args_info->breakdown_given = 0 ;
+  args_info->outlier_given = 0 ;
+  args_info->size_buckets_given = 0 ;
+  args_info->ops_given = 0 ;
+  args_info->rmw_retries_given = 0 ;
+  args_info->fill_given = 0 ;
+  args_info->ttl_given = 0 ;
+  args_info->working_set_given = 0 ;
+  args_info->timeline_given = 0 ;
+  args_info->server_stats_given = 0 ;
+  args_info->stats_interval_given = 0 ;
   args_info->agentmode_given = 0 ;
   args_info->agent_given = 0 ;
   args_info->agent_port_given = 0 ;
@@ -240,6 +299,50 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->keycache_reuse_orig = NULL;
   args_info->keycache_regen_arg = 1;
   args_info->keycache_regen_orig = NULL;
+  args_info->slo_arg = NULL;
+  args_info->slo_orig = NULL;
+  args_info->slo_gains_arg = gengetopt_strdup ("0.5,0.3");
+  args_info->slo_gains_orig = NULL;
+  args_info->interval_arg = 1.0;
+  args_info->interval_orig = NULL;
+  args_info->ci_orig = NULL;
+  args_info->ci_nth_arg = 99;
+  args_info->ci_nth_orig = NULL;
+  args_info->dataset_arg = NULL;
+  args_info->dataset_orig = NULL;
+  args_info->replay_arg = NULL;
+  args_info->replay_orig = NULL;
+  args_info->speedup_arg = 1.0;
+  args_info->speedup_orig = NULL;
+  args_info->record_arg = NULL;
+  args_info->record_orig = NULL;
+  args_info->cdf_table_arg = 0;
+  args_info->cdf_table_orig = NULL;
+  args_info->cdf_table_error_arg = 0.001;
+  args_info->cdf_table_error_orig = NULL;
+  args_info->seed_arg = 1;
+  args_info->seed_orig = NULL;
+  args_info->key_drift_arg = NULL;
+  args_info->key_drift_orig = NULL;
+  args_info->flash_crowd_arg = NULL;
+  args_info->flash_crowd_orig = NULL;
+  args_info->breakdown_arg = NULL;
+  args_info->breakdown_orig = NULL;
+  args_info->outlier_arg = 2;
+  args_info->outlier_orig = NULL;
+  args_info->size_buckets_arg = NULL;
+  args_info->size_buckets_orig = NULL;
+  args_info->ops_arg = NULL;
+  args_info->ops_orig = NULL;
+  args_info->rmw_retries_arg = 10;
+  args_info->rmw_retries_orig = NULL;
+  args_info->fill_arg = NULL;
+  args_info->fill_orig = NULL;
+  args_info->ttl_arg = NULL;
+  args_info->ttl_orig = NULL;
+  args_info->working_set_orig = NULL;
+  args_info->stats_interval_arg = 0;
+  args_info->stats_interval_orig = NULL;
   args_info->agent_arg = NULL;
   args_info->agent_orig = NULL;
   args_info->agent_port_arg = gengetopt_strdup ("5556");
@@ -305,17 +408,46 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->keycache_reuse_help = gengetopt_args_info_help[39] ;
   args_info->keycache_regen_help = gengetopt_args_info_help[40] ;
   args_info->plot_all_help = gengetopt_args_info_help[41] ;
-  args_info->agentmode_help = gengetopt_args_info_help[43] ;
-  args_info->agent_help = gengetopt_args_info_help[44] ;
+  args_info->slo_help = gengetopt_args_info_help[42] ;
+  args_info->slo_gains_help = gengetopt_args_info_help[43] ;
+  args_info->interval_help = gengetopt_args_info_help[44] ;
+  args_info->auto_warmup_help = gengetopt_args_info_help[45] ;
+  args_info->ci_help = gengetopt_args_info_help[46] ;
+  args_info->ci_nth_help = gengetopt_args_info_help[47] ;
+  args_info->dataset_help = gengetopt_args_info_help[48] ;
+  args_info->replay_help = gengetopt_args_info_help[49] ;
+  args_info->speedup_help = gengetopt_args_info_help[50] ;
+  args_info->record_help = gengetopt_args_info_help[51] ;
+  args_info->cdf_table_help = gengetopt_args_info_help[52] ;
+  args_info->cdf_table_error_help = gengetopt_args_info_help[53] ;
+  args_info->cdf_table_nearest_help = gengetopt_args_info_help[54] ;
+  args_info->seed_help = gengetopt_args_info_help[55] ;
+  args_info->key_drift_help = gengetopt_args_info_help[56] ;
+  args_info->flash_crowd_help = gengetopt_args_info_help[57] ;
+  args_info->ketama_help = gengetopt_args_info_help[58] ;
+  args_info->fanout_help = gengetopt_args_info_help[59] ;
+  args_info->breakdown_help = gengetopt_args_info_help[60] ;
+  args_info->outlier_help = gengetopt_args_info_help[61] ;
+  args_info->size_buckets_help = gengetopt_args_info_help[62] ;
+  args_info->ops_help = gengetopt_args_info_help[63] ;
+  args_info->rmw_retries_help = gengetopt_args_info_help[64] ;
+  args_info->fill_help = gengetopt_args_info_help[65] ;
+  args_info->ttl_help = gengetopt_args_info_help[66] ;
+  args_info->working_set_help = gengetopt_args_info_help[67] ;
+  args_info->timeline_help = gengetopt_args_info_help[68] ;
+  args_info->server_stats_help = gengetopt_args_info_help[69] ;
+  args_info->stats_interval_help = gengetopt_args_info_help[70] ;
+  args_info->agentmode_help = gengetopt_args_info_help[72] ;
+  args_info->agent_help = gengetopt_args_info_help[73] ;
   args_info->agent_min = 0;
   args_info->agent_max = 0;
-  args_info->agent_port_help = gengetopt_args_info_help[45] ;
-  args_info->lambda_mul_help = gengetopt_args_info_help[46] ;
-  args_info->measure_connections_help = gengetopt_args_info_help[47] ;
-  args_info->measure_qps_help = gengetopt_args_info_help[48] ;
-  args_info->measure_depth_help = gengetopt_args_info_help[49] ;
-  args_info->poll_freq_help = gengetopt_args_info_help[50] ;
-  args_info->poll_max_help = gengetopt_args_info_help[51] ;
+  args_info->agent_port_help = gengetopt_args_info_help[74] ;
+  args_info->lambda_mul_help = gengetopt_args_info_help[75] ;
+  args_info->measure_connections_help = gengetopt_args_info_help[76] ;
+  args_info->measure_qps_help = gengetopt_args_info_help[77] ;
+  args_info->measure_depth_help = gengetopt_args_info_help[78] ;
+  args_info->poll_freq_help = gengetopt_args_info_help[79] ;
+  args_info->poll_max_help = gengetopt_args_info_help[80] ;
   
 }
 
@@ -397,6 +529,7 @@ free_string_field (char **s)
 /** @brief generic value variable */
 union generic_value {
     int int_arg;
+    long long_arg;
     float float_arg;
     char *string_arg;
     const char *default_string_arg;
@@ -479,6 +612,41 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->keycache_capacity_orig));
   free_string_field (&(args_info->keycache_reuse_orig));
   free_string_field (&(args_info->keycache_regen_orig));
+  free_string_field (&(args_info->slo_arg));
+  free_string_field (&(args_info->slo_orig));
+  free_string_field (&(args_info->slo_gains_arg));
+  free_string_field (&(args_info->slo_gains_orig));
+  free_string_field (&(args_info->interval_orig));
+  free_string_field (&(args_info->ci_orig));
+  free_string_field (&(args_info->ci_nth_orig));
+  free_string_field (&(args_info->dataset_arg));
+  free_string_field (&(args_info->dataset_orig));
+  free_string_field (&(args_info->replay_arg));
+  free_string_field (&(args_info->replay_orig));
+  free_string_field (&(args_info->speedup_orig));
+  free_string_field (&(args_info->record_arg));
+  free_string_field (&(args_info->record_orig));
+  free_string_field (&(args_info->cdf_table_orig));
+  free_string_field (&(args_info->cdf_table_error_orig));
+  free_string_field (&(args_info->seed_orig));
+  free_string_field (&(args_info->key_drift_arg));
+  free_string_field (&(args_info->key_drift_orig));
+  free_string_field (&(args_info->flash_crowd_arg));
+  free_string_field (&(args_info->flash_crowd_orig));
+  free_string_field (&(args_info->breakdown_arg));
+  free_string_field (&(args_info->breakdown_orig));
+  free_string_field (&(args_info->outlier_orig));
+  free_string_field (&(args_info->size_buckets_arg));
+  free_string_field (&(args_info->size_buckets_orig));
+  free_string_field (&(args_info->ops_arg));
+  free_string_field (&(args_info->ops_orig));
+  free_string_field (&(args_info->rmw_retries_orig));
+  free_string_field (&(args_info->fill_arg));
+  free_string_field (&(args_info->fill_orig));
+  free_string_field (&(args_info->ttl_arg));
+  free_string_field (&(args_info->ttl_orig));
+  free_string_field (&(args_info->working_set_orig));
+  free_string_field (&(args_info->stats_interval_orig));
   free_multiple_string_field (args_info->agent_given, &(args_info->agent_arg), &(args_info->agent_orig));
   free_string_field (&(args_info->agent_port_arg));
   free_string_field (&(args_info->agent_port_orig));
@@ -604,6 +772,64 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "keycache_regen", args_info->keycache_regen_orig, 0);
   if (args_info->plot_all_given)
     write_into_file(outfile, "plot_all", 0, 0 );
+  if (args_info->slo_given)
+    write_into_file(outfile, "slo", args_info->slo_orig, 0);
+  if (args_info->slo_gains_given)
+    write_into_file(outfile, "slo_gains", args_info->slo_gains_orig, 0);
+  if (args_info->interval_given)
+    write_into_file(outfile, "interval", args_info->interval_orig, 0);
+  if (args_info->auto_warmup_given)
+    write_into_file(outfile, "auto_warmup", 0, 0 );
+  if (args_info->ci_given)
+    write_into_file(outfile, "ci", args_info->ci_orig, 0);
+  if (args_info->ci_nth_given)
+    write_into_file(outfile, "ci_nth", args_info->ci_nth_orig, 0);
+  if (args_info->dataset_given)
+    write_into_file(outfile, "dataset", args_info->dataset_orig, 0);
+  if (args_info->replay_given)
+    write_into_file(outfile, "replay", args_info->replay_orig, 0);
+  if (args_info->speedup_given)
+    write_into_file(outfile, "speedup", args_info->speedup_orig, 0);
+  if (args_info->record_given)
+    write_into_file(outfile, "record", args_info->record_orig, 0);
+  if (args_info->cdf_table_given)
+    write_into_file(outfile, "cdf_table", args_info->cdf_table_orig, 0);
+  if (args_info->cdf_table_error_given)
+    write_into_file(outfile, "cdf_table_error", args_info->cdf_table_error_orig, 0);
+  if (args_info->cdf_table_nearest_given)
+    write_into_file(outfile, "cdf_table_nearest", 0, 0 );
+  if (args_info->seed_given)
+    write_into_file(outfile, "seed", args_info->seed_orig, 0);
+  if (args_info->key_drift_given)
+    write_into_file(outfile, "key_drift", args_info->key_drift_orig, 0);
+  if (args_info->flash_crowd_given)
+    write_into_file(outfile, "flash_crowd", args_info->flash_crowd_orig, 0);
+  if (args_info->ketama_given)
+    write_into_file(outfile, "ketama", 0, 0 );
+  if (args_info->fanout_given)
+    write_into_file(outfile, "fanout", 0, 0 );
+  if (args_info->breakdown_given)
+    write_into_file(outfile, "breakdown", args_info->breakdown_orig, 0);
+  if (args_info->outlier_given)
+    write_into_file(outfile, "outlier", args_info->outlier_orig, 0);
+  if (args_info->size_buckets_given)
+    write_into_file(outfile, "size_buckets", args_info->size_buckets_orig, 0);
+  if (args_info->ops_given)
+    write_into_file(outfile, "ops", args_info->ops_orig, 0);
+  if (args_info->rmw_retries_given)
+    write_into_file(outfile, "rmw_retries", args_info->rmw_retries_orig, 0);
+  if (args_info->fill_given)
+    write_into_file(outfile, "fill", args_info->fill_orig, 0);
+  if (args_info->ttl_given)
+    write_into_file(outfile, "ttl", args_info->ttl_orig, 0);
+  if (args_info->working_set_given)
+    write_into_file(outfile, "working_set", args_info->working_set_orig, 0);
+  if (args_info->timeline_given)
+    write_into_file(outfile, "timeline", 0, 0 );
+  if (args_info->server_stats_given)
+    write_into_file(outfile, "server_stats", 0, 0 );
+  if (args_info->stats_interval_given)
+    write_into_file(outfile, "stats_interval", args_info->stats_interval_orig, 0);
   if (args_info->agentmode_given)
     write_into_file(outfile, "agentmode", 0, 0 );
   write_multiple_into_file(outfile, args_info->agent_given, "agent", args_info->agent_orig, 0);
@@ -956,6 +1182,9 @@ int update_arg(void *field, char **orig_field,
   case ARG_INT:
     if (val) *((int *)field) = strtol (val, &stop_char, 0);
     break;
+  case ARG_LONG:
+    if (val) *((long *)field) = (long)strtol (val, &stop_char, 0);
+    break;
   case ARG_FLOAT:
     if (val) *((float *)field) = (float)strtod (val, &stop_char);
     break;
@@ -974,6 +1203,7 @@ int update_arg(void *field, char **orig_field,
   /* check numeric conversion */
   switch(arg_type) {
   case ARG_INT:
+  case ARG_LONG:
   case ARG_FLOAT:
     if (val && !(stop_char && *stop_char == '\0')) {
       fprintf(stderr, "%s: invalid numeric value: %s\n", package_name, val);
@@ -1224,6 +1454,35 @@ cmdline_parser_internal (
         { "keycache_reuse",	1, NULL, 0 },
         { "keycache_regen",	1, NULL, 0 },
         { "plot_all",	0, NULL, 0 },
+        { "slo",	1, NULL, 0 },
+        { "slo_gains",	1, NULL, 0 },
+        { "interval",	1, NULL, 0 },
+        { "auto_warmup",	0, NULL, 0 },
+        { "ci",	1, NULL, 0 },
+        { "ci_nth",	1, NULL, 0 },
+        { "dataset",	1, NULL, 0 },
+        { "replay",	1, NULL, 0 },
+        { "speedup",	1, NULL, 0 },
+        { "record",	1, NULL, 0 },
+        { "cdf_table",	1, NULL, 0 },
+        { "cdf_table_error",	1, NULL, 0 },
+        { "cdf_table_nearest",	0, NULL, 0 },
+        { "seed",	1, NULL, 0 },
+        { "key_drift",	1, NULL, 0 },
+        { "flash_crowd",	1, NULL, 0 },
+        { "ketama",	0, NULL, 0 },
+        { "fanout",	0, NULL, 0 },
+        { "breakdown",	1, NULL, 0 },
+        { "outlier",	1, NULL, 0 },
+        { "size_buckets",	1, NULL, 0 },
+        { "ops",	1, NULL, 0 },
+        { "rmw_retries",	1, NULL, 0 },
+        { "fill",	1, NULL, 0 },
+        { "ttl",	1, NULL, 0 },
+        { "working_set",	1, NULL, 0 },
+        { "timeline",	0, NULL, 0 },
+        { "server_stats",	0, NULL, 0 },
+        { "stats_interval",	1, NULL, 0 },
         { "agentmode",	0, NULL, 'A' },
         { "agent",	1, NULL, 'a' },
         { "agent_port",	1, NULL, 'p' },
@@ -1314,7 +1573,7 @@ cmdline_parser_internal (
         
           if (update_arg( (void *)&(args_info->records_arg), 
                &(args_info->records_orig), &(args_info->records_given),
-              &(local_args_info.records_given), optarg, 0, "10000", ARG_INT,
+              &(local_args_info.records_given), optarg, 0, "10000", ARG_LONG,
               check_ambiguity, override, 0, 0,
               "records", 'r',
               additional_error))
@@ -1837,6 +2096,412 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Closed-loop mode.  Continuously adjust the QPS of every thread and agent to hold the N-order statistic at Xus (i.e. --slo 99:1000 holds p99 at 1ms) and report the sustainable QPS..  */
+          else if (strcmp (long_options[option_index].name, "slo") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->slo_arg), 
+                 &(args_info->slo_orig), &(args_info->slo_given),
+                &(local_args_info.slo_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "slo", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Proportional and integral gains of the --slo controller..  */
+          else if (strcmp (long_options[option_index].name, "slo_gains") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->slo_gains_arg), 
+                 &(args_info->slo_gains_orig), &(args_info->slo_gains_given),
+                &(local_args_info.slo_gains_given), optarg, 0, "0.5,0.3", ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "slo_gains", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Length in seconds of the measurement interval used by --slo, --auto_warmup and --ci..  */
+          else if (strcmp (long_options[option_index].name, "interval") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->interval_arg), 
+                 &(args_info->interval_orig), &(args_info->interval_given),
+                &(local_args_info.interval_given), optarg, 0, "1.0", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "interval", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Keep warming up until the interval QPS and latency stop trending (MSER test), for at most --warmup seconds (--time if not given)..  */
+          else if (strcmp (long_options[option_index].name, "auto_warmup") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->auto_warmup_given),
+                &(local_args_info.auto_warmup_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "auto_warmup", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Stop measuring once the 95% confidence interval of the --ci_nth latency is within this fraction of its value (e.g. 0.05), for at most --time seconds..  */
+          else if (strcmp (long_options[option_index].name, "ci") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->ci_arg), 
+                 &(args_info->ci_orig), &(args_info->ci_given),
+                &(local_args_info.ci_given), optarg, 0, 0, ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "ci", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Latency percentile used by --ci..  */
+          else if (strcmp (long_options[option_index].name, "ci_nth") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->ci_nth_arg), 
+                 &(args_info->ci_nth_orig), &(args_info->ci_nth_given),
+                &(local_args_info.ci_nth_given), optarg, 0, "99", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "ci_nth", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Load the records from a binary key/value dataset file (see Dataset.h for the format) instead of generating them, and draw the request keys from it.  Overrides --records..  */
+          else if (strcmp (long_options[option_index].name, "dataset") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->dataset_arg), 
+                 &(args_info->dataset_orig), &(args_info->dataset_given),
+                &(local_args_info.dataset_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "dataset", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Replay a binary request trace (see Trace.h for the format) instead of generating requests, for at most --time seconds..  */
+          else if (strcmp (long_options[option_index].name, "replay") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->replay_arg), 
+                 &(args_info->replay_orig), &(args_info->replay_given),
+                &(local_args_info.replay_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "replay", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Time-scale factor for --replay (2 replays the trace twice as fast)..  */
+          else if (strcmp (long_options[option_index].name, "speedup") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->speedup_arg), 
+                 &(args_info->speedup_orig), &(args_info->speedup_given),
+                &(local_args_info.speedup_given), optarg, 0, "1.0", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "speedup", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Record the issued requests (intended time, op, key, value size, connection) to a trace that --replay can run.  Gets and sets only; --fill sets are left out.  Later runs of --scan or --search write FILE.1, FILE.2, ....  */
+          else if (strcmp (long_options[option_index].name, "record") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->record_arg), 
+                 &(args_info->record_orig), &(args_info->record_given),
+                &(local_args_info.record_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "record", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Tabulate the inverse CDF of the continuous distributions (normal, exponential, pareto, gev, the fb_* tails) at INT points, 0 = exact..  */
+          else if (strcmp (long_options[option_index].name, "cdf_table") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->cdf_table_arg), 
+                 &(args_info->cdf_table_orig), &(args_info->cdf_table_given),
+                &(local_args_info.cdf_table_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "cdf_table", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Largest relative error of a --cdf_table interval; intervals above it use the exact distribution..  */
+          else if (strcmp (long_options[option_index].name, "cdf_table_error") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->cdf_table_error_arg), 
+                 &(args_info->cdf_table_error_orig), &(args_info->cdf_table_error_given),
+                &(local_args_info.cdf_table_error_given), optarg, 0, "0.001", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "cdf_table_error", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Use the nearest --cdf_table entry instead of interpolating..  */
+          else if (strcmp (long_options[option_index].name, "cdf_table_nearest") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->cdf_table_nearest_given),
+                &(local_args_info.cdf_table_nearest_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "cdf_table_nearest", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Seed of the per-thread random number generators.  Each thread (and agent) draws its own stream, so runs are repeatable; 0 seeds from the clock..  */
+          else if (strcmp (long_options[option_index].name, "seed") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->seed_arg), 
+                 &(args_info->seed_orig), &(args_info->seed_given),
+                &(local_args_info.seed_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "seed", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Rotate the key popularity ranking by RATE keys per second, or by RATE*PERIOD keys every PERIOD seconds..  */
+          else if (strcmp (long_options[option_index].name, "key_drift") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->key_drift_arg), 
+                 &(args_info->key_drift_orig), &(args_info->key_drift_given),
+                &(local_args_info.key_drift_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "key_drift", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* At T seconds into the run, send SHARE (0-1) of the requests to a hot set of KEYS keys (default 10) for DURATION seconds, and report the read latency before, during and after it..  */
+          else if (strcmp (long_options[option_index].name, "flash_crowd") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->flash_crowd_arg), 
+                 &(args_info->flash_crowd_orig), &(args_info->flash_crowd_given),
+                &(local_args_info.flash_crowd_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "flash_crowd", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Route every op to the server owning its key on a ketama consistent-hash continuum, over one keyspace of --records keys, and report the load and latency of each server..  */
+          else if (strcmp (long_options[option_index].name, "ketama") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->ketama_given),
+                &(local_args_info.ketama_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "ketama", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* With --ketama, split every multi-get (--getq_freq) into one part per server owning some of its keys, sent in parallel, and report the per-part and end-to-end latency..  */
+          else if (strcmp (long_options[option_index].name, "fanout") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->fanout_given),
+                &(local_args_info.fanout_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "fanout", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Report the load and latency of every server, or of every connection too, and flag those whose p99 is more than --outlier times the median one's..  */
+          else if (strcmp (long_options[option_index].name, "breakdown") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->breakdown_arg), 
+                 &(args_info->breakdown_orig), &(args_info->breakdown_given),
+                &(local_args_info.breakdown_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "breakdown", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Outlier threshold of --breakdown, as a multiple of the median p99..  */
+          else if (strcmp (long_options[option_index].name, "outlier") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->outlier_arg), 
+                 &(args_info->outlier_orig), &(args_info->outlier_given),
+                &(local_args_info.outlier_given), optarg, 0, "2", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "outlier", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Also report the latency, QPS and bandwidth of gets and sets by value size: power-of-two buckets, or the slab class of the item with memcached's default settings..  */
+          else if (strcmp (long_options[option_index].name, "size_buckets") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->size_buckets_arg), 
+                 &(args_info->size_buckets_orig), &(args_info->size_buckets_given),
+                &(local_args_info.size_buckets_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "size_buckets", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Weighted op mix replacing --update, e.g. get:80,set:10,delete:3,incr:5,touch:2. Ops: get set delete incr decr append prepend touch gat cas gets rmw (gets then cas, see --rmw_retries). Gets are multi-gets as often as --getq_freq says; incr and decr step counters of their own, set to 0 before the run, with --noload too..  */
+          else if (strcmp (long_options[option_index].name, "ops") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->ops_arg), 
+                 &(args_info->ops_orig), &(args_info->ops_given),
+                &(local_args_info.ops_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "ops", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Times an rmw of --ops goes back to its gets after its cas meets EXISTS before it gives up..  */
+          else if (strcmp (long_options[option_index].name, "rmw_retries") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->rmw_retries_arg), 
+                 &(args_info->rmw_retries_orig), &(args_info->rmw_retries_given),
+                &(local_args_info.rmw_retries_given), optarg, 0, "10", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "rmw_retries", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Cache-aside: after a get misses, wait a backend delay drawn from DIST (microseconds, e.g. fixed:1000 or exponential:0.001) and set the key on the same connection..  */
+          else if (strcmp (long_options[option_index].name, "fill") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->fill_arg), 
+                 &(args_info->fill_orig), &(args_info->fill_given),
+                &(local_args_info.fill_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "fill", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Expiration time of every set, fill, cas, touch and gat, drawn from DIST (seconds, e.g. fixed:60 or exponential:0.01), clamped to memcached's 30 days.  The loader's sets get one too..  */
+          else if (strcmp (long_options[option_index].name, "ttl") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->ttl_arg), 
+                 &(args_info->ttl_orig), &(args_info->ttl_given),
+                &(local_args_info.ttl_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "ttl", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Size --records to FACTOR times the memory of the servers (their limit_maxbytes over the mean slab chunk of an item), so FACTOR > 1 keeps them evicting.  Implies --timeline..  */
+          else if (strcmp (long_options[option_index].name, "working_set") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->working_set_arg), 
+                 &(args_info->working_set_orig), &(args_info->working_set_given),
+                &(local_args_info.working_set_given), optarg, 0, 0, ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "working_set", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Report the hit ratio and the servers' curr_items, memory use, evictions and reclaims every --interval, the latter from a stats side connection to every server..  */
+          else if (strcmp (long_options[option_index].name, "timeline") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->timeline_given),
+                &(local_args_info.timeline_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "timeline", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Add the servers' stats, stats slabs and stats items to the --timeline: server QPS and its agreement with this client's (not with --agent), cmd_get rate, conn_yields and CPU per row, and a per slab class summary of the run.  Implies --timeline..  */
+          else if (strcmp (long_options[option_index].name, "server_stats") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->server_stats_given),
+                &(local_args_info.server_stats_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "server_stats", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Length of a --timeline row, the period the servers are polled at; rounded to a whole number of --intervals, 0 = one --interval..  */
+          else if (strcmp (long_options[option_index].name, "stats_interval") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->stats_interval_arg), 
+                 &(args_info->stats_interval_orig), &(args_info->stats_interval_given),
+                &(local_args_info.stats_interval_given), optarg, 0, "0", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "stats_interval", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
@@ -67,7 +67,7 @@ struct gengetopt_args_info
   char * valuesize_arg;	/**< @brief Length of memcached values (distribution). (default='200').  */
   char * valuesize_orig;	/**< @brief Length of memcached values (distribution). original value given at command line.  */
   const char *valuesize_help; /**< @brief Length of memcached values (distribution). help description.  */
-  int records_arg;	/**< @brief Number of memcached records to use.  If multiple memcached servers are given, this number is divided by the number of servers. (default='10000').  */
+  long records_arg;	/**< @brief Number of memcached records to use.  If multiple memcached servers are given, this number is divided by the number of servers. (default='10000').  */
   char * records_orig;	/**< @brief Number of memcached records to use.  If multiple memcached servers are given, this number is divided by the number of servers. original value given at command line.  */
   const char *records_help; /**< @brief Number of memcached records to use.  If multiple memcached servers are given, this number is divided by the number of servers. help description.  */
   float update_arg;	/**< @brief Ratio of set:get commands. (default='0.0').  */
@@ -131,6 +131,81 @@ struct gengetopt_args_info
   char * keycache_regen_orig;	/**< @brief When regenerating control number of requests to regenerate. (Default 1%) original value given at command line.  */
   const char *keycache_regen_help; /**< @brief When regenerating control number of requests to regenerate. (Default 1%) help description.  */
   const char *plot_all_help; /**< @brief Create plot/csv of latency histogram at each step when using gnuplot and loghistogram sampler help description.  */
+  char * slo_arg;	/**< @brief Closed-loop mode.  Continuously adjust the QPS of every thread and agent to hold the N-order statistic at Xus (i.e. --slo 99:1000 holds p99 at 1ms) and report the sustainable QPS..  */
+  char * slo_orig;	/**< @brief Closed-loop mode.  Continuously adjust the QPS of every thread and agent to hold the N-order statistic at Xus (i.e. --slo 99:1000 holds p99 at 1ms) and report the sustainable QPS. original value given at command line.  */
+  const char *slo_help; /**< @brief Closed-loop mode.  Continuously adjust the QPS of every thread and agent to hold the N-order statistic at Xus (i.e. --slo 99:1000 holds p99 at 1ms) and report the sustainable QPS. help description.  */
+  char * slo_gains_arg;	/**< @brief Proportional and integral gains of the --slo controller. (default='0.5,0.3').  */
+  char * slo_gains_orig;	/**< @brief Proportional and integral gains of the --slo controller. original value given at command line.  */
+  const char *slo_gains_help; /**< @brief Proportional and integral gains of the --slo controller. help description.  */
+  float interval_arg;	/**< @brief Length in seconds of the measurement interval used by --slo, --auto_warmup and --ci. (default='1.0').  */
+  char * interval_orig;	/**< @brief Length in seconds of the measurement interval used by --slo, --auto_warmup and --ci. original value given at command line.  */
+  const char *interval_help; /**< @brief Length in seconds of the measurement interval used by --slo, --auto_warmup and --ci. help description.  */
+  const char *auto_warmup_help; /**< @brief Keep warming up until the interval QPS and latency stop trending (MSER test), for at most --warmup seconds (--time if not given). help description.  */
+  float ci_arg;	/**< @brief Stop measuring once the 95% confidence interval of the --ci_nth latency is within this fraction of its value (e.g. 0.05), for at most --time seconds..  */
+  char * ci_orig;	/**< @brief Stop measuring once the 95% confidence interval of the --ci_nth latency is within this fraction of its value (e.g. 0.05), for at most --time seconds. original value given at command line.  */
+  const char *ci_help; /**< @brief Stop measuring once the 95% confidence interval of the --ci_nth latency is within this fraction of its value (e.g. 0.05), for at most --time seconds. help description.  */
+  float ci_nth_arg;	/**< @brief Latency percentile used by --ci. (default='99').  */
+  char * ci_nth_orig;	/**< @brief Latency percentile used by --ci. original value given at command line.  */
+  const char *ci_nth_help; /**< @brief Latency percentile used by --ci. help description.  */
+  char * dataset_arg;	/**< @brief Load the records from a binary key/value dataset file (see Dataset.h for the format) instead of generating them, and draw the request keys from it.  Overrides --records..  */
+  char * dataset_orig;	/**< @brief Load the records from a binary key/value dataset file (see Dataset.h for the format) instead of generating them, and draw the request keys from it.  Overrides --records. original value given at command line.  */
+  const char *dataset_help; /**< @brief Load the records from a binary key/value dataset file (see Dataset.h for the format) instead of generating them, and draw the request keys from it.  Overrides --records. help description.  */
+  char * replay_arg;	/**< @brief Replay a binary request trace (see Trace.h for the format) instead of generating requests, for at most --time seconds..  */
+  char * replay_orig;	/**< @brief Replay a binary request trace (see Trace.h for the format) instead of generating requests, for at most --time seconds. original value given at command line.  */
+  const char *replay_help; /**< @brief Replay a binary request trace (see Trace.h for the format) instead of generating requests, for at most --time seconds. help description.  */
+  float speedup_arg;	/**< @brief Time-scale factor for --replay (2 replays the trace twice as fast). (default='1.0').  */
+  char * speedup_orig;	/**< @brief Time-scale factor for --replay (2 replays the trace twice as fast). original value given at command line.  */
+  const char *speedup_help; /**< @brief Time-scale factor for --replay (2 replays the trace twice as fast). help description.  */
+  char * record_arg;	/**< @brief Record the issued requests (intended time, op, key, value size, connection) to a trace that --replay can run.  Gets and sets only; --fill sets are left out.  Later runs of --scan or --search write FILE.1, FILE.2, ....  */
+  char * record_orig;	/**< @brief Record the issued requests (intended time, op, key, value size, connection) to a trace that --replay can run.  Gets and sets only; --fill sets are left out.  Later runs of --scan or --search write FILE.1, FILE.2, ... original value given at command line.  */
+  const char *record_help; /**< @brief Record the issued requests (intended time, op, key, value size, connection) to a trace that --replay can run.  Gets and sets only; --fill sets are left out.  Later runs of --scan or --search write FILE.1, FILE.2, ... help description.  */
+  int cdf_table_arg;	/**< @brief Tabulate the inverse CDF of the continuous distributions (normal, exponential, pareto, gev, the fb_* tails) at INT points, 0 = exact. (default='0').  */
+  char * cdf_table_orig;	/**< @brief Tabulate the inverse CDF of the continuous distributions (normal, exponential, pareto, gev, the fb_* tails) at INT points, 0 = exact. original value given at command line.  */
+  const char *cdf_table_help; /**< @brief Tabulate the inverse CDF of the continuous distributions (normal, exponential, pareto, gev, the fb_* tails) at INT points, 0 = exact. help description.  */
+  float cdf_table_error_arg;	/**< @brief Largest relative error of a --cdf_table interval; intervals above it use the exact distribution. (default='0.001').  */
+  char * cdf_table_error_orig;	/**< @brief Largest relative error of a --cdf_table interval; intervals above it use the exact distribution. original value given at command line.  */
+  const char *cdf_table_error_help; /**< @brief Largest relative error of a --cdf_table interval; intervals above it use the exact distribution. help description.  */
+  const char *cdf_table_nearest_help; /**< @brief Use the nearest --cdf_table entry instead of interpolating. help description.  */
+  int seed_arg;	/**< @brief Seed of the per-thread random number generators.  Each thread (and agent) draws its own stream, so runs are repeatable; 0 seeds from the clock. (default='1').  */
+  char * seed_orig;	/**< @brief Seed of the per-thread random number generators.  Each thread (and agent) draws its own stream, so runs are repeatable; 0 seeds from the clock. original value given at command line.  */
+  const char *seed_help; /**< @brief Seed of the per-thread random number generators.  Each thread (and agent) draws its own stream, so runs are repeatable; 0 seeds from the clock. help description.  */
+  char * key_drift_arg;	/**< @brief Rotate the key popularity ranking by RATE keys per second, or by RATE*PERIOD keys every PERIOD seconds..  */
+  char * key_drift_orig;	/**< @brief Rotate the key popularity ranking by RATE keys per second, or by RATE*PERIOD keys every PERIOD seconds. original value given at command line.  */
+  const char *key_drift_help; /**< @brief Rotate the key popularity ranking by RATE keys per second, or by RATE*PERIOD keys every PERIOD seconds. help description.  */
+  char * flash_crowd_arg;	/**< @brief At T seconds into the run, send SHARE (0-1) of the requests to a hot set of KEYS keys (default 10) for DURATION seconds, and report the read latency before, during and after it..  */
+  char * flash_crowd_orig;	/**< @brief At T seconds into the run, send SHARE (0-1) of the requests to a hot set of KEYS keys (default 10) for DURATION seconds, and report the read latency before, during and after it. original value given at command line.  */
+  const char *flash_crowd_help; /**< @brief At T seconds into the run, send SHARE (0-1) of the requests to a hot set of KEYS keys (default 10) for DURATION seconds, and report the read latency before, during and after it. help description.  */
+  const char *ketama_help; /**< @brief Route every op to the server owning its key on a ketama consistent-hash continuum, over one keyspace of --records keys, and report the load and latency of each server. help description.  */
+  const char *fanout_help; /**< @brief With --ketama, split every multi-get (--getq_freq) into one part per server owning some of its keys, sent in parallel, and report the per-part and end-to-end latency. help description.  */
+  char * breakdown_arg;	/**< @brief Report the load and latency of every server, or of every connection too, and flag those whose p99 is more than --outlier times the median one's..  */
+  char * breakdown_orig;	/**< @brief Report the load and latency of every server, or of every connection too, and flag those whose p99 is more than --outlier times the median one's. original value given at command line.  */
+  const char *breakdown_help; /**< @brief Report the load and latency of every server, or of every connection too, and flag those whose p99 is more than --outlier times the median one's. help description.  */
+  float outlier_arg;	/**< @brief Outlier threshold of --breakdown, as a multiple of the median p99. (default='2').  */
+  char * outlier_orig;	/**< @brief Outlier threshold of --breakdown, as a multiple of the median p99. original value given at command line.  */
+  const char *outlier_help; /**< @brief Outlier threshold of --breakdown, as a multiple of the median p99. help description.  */
+  char * size_buckets_arg;	/**< @brief Also report the latency, QPS and bandwidth of gets and sets by value size: power-of-two buckets, or the slab class of the item with memcached's default settings..  */
+  char * size_buckets_orig;	/**< @brief Also report the latency, QPS and bandwidth of gets and sets by value size: power-of-two buckets, or the slab class of the item with memcached's default settings. original value given at command line.  */
+  const char *size_buckets_help; /**< @brief Also report the latency, QPS and bandwidth of gets and sets by value size: power-of-two buckets, or the slab class of the item with memcached's default settings. help description.  */
+  char * ops_arg;	/**< @brief Weighted op mix replacing --update, e.g. get:80,set:10,delete:3,incr:5,touch:2. Ops: get set delete incr decr append prepend touch gat cas gets rmw (gets then cas, see --rmw_retries). Gets are multi-gets as often as --getq_freq says; incr and decr step counters of their own, set to 0 before the run, with --noload too..  */
+  char * ops_orig;	/**< @brief Weighted op mix replacing --update, e.g. get:80,set:10,delete:3,incr:5,touch:2. Ops: get set delete incr decr append prepend touch gat cas gets rmw (gets then cas, see --rmw_retries). Gets are multi-gets as often as --getq_freq says; incr and decr step counters of their own, set to 0 before the run, with --noload too. original value given at command line.  */
+  const char *ops_help; /**< @brief Weighted op mix replacing --update, e.g. get:80,set:10,delete:3,incr:5,touch:2. Ops: get set delete incr decr append prepend touch gat cas gets rmw (gets then cas, see --rmw_retries). Gets are multi-gets as often as --getq_freq says; incr and decr step counters of their own, set to 0 before the run, with --noload too. help description.  */
+  int rmw_retries_arg;	/**< @brief Times an rmw of --ops goes back to its gets after its cas meets EXISTS before it gives up. (default='10').  */
+  char * rmw_retries_orig;	/**< @brief Times an rmw of --ops goes back to its gets after its cas meets EXISTS before it gives up. original value given at command line.  */
+  const char *rmw_retries_help; /**< @brief Times an rmw of --ops goes back to its gets after its cas meets EXISTS before it gives up. help description.  */
+  char * fill_arg;	/**< @brief Cache-aside: after a get misses, wait a backend delay drawn from DIST (microseconds, e.g. fixed:1000 or exponential:0.001) and set the key on the same connection..  */
+  char * fill_orig;	/**< @brief Cache-aside: after a get misses, wait a backend delay drawn from DIST (microseconds, e.g. fixed:1000 or exponential:0.001) and set the key on the same connection. original value given at command line.  */
+  const char *fill_help; /**< @brief Cache-aside: after a get misses, wait a backend delay drawn from DIST (microseconds, e.g. fixed:1000 or exponential:0.001) and set the key on the same connection. help description.  */
+  char * ttl_arg;	/**< @brief Expiration time of every set, fill, cas, touch and gat, drawn from DIST (seconds, e.g. fixed:60 or exponential:0.01), clamped to memcached's 30 days.  The loader's sets get one too..  */
+  char * ttl_orig;	/**< @brief Expiration time of every set, fill, cas, touch and gat, drawn from DIST (seconds, e.g. fixed:60 or exponential:0.01), clamped to memcached's 30 days.  The loader's sets get one too. original value given at command line.  */
+  const char *ttl_help; /**< @brief Expiration time of every set, fill, cas, touch and gat, drawn from DIST (seconds, e.g. fixed:60 or exponential:0.01), clamped to memcached's 30 days.  The loader's sets get one too. help description.  */
+  float working_set_arg;	/**< @brief Size --records to FACTOR times the memory of the servers (their limit_maxbytes over the mean slab chunk of an item), so FACTOR > 1 keeps them evicting.  Implies --timeline..  */
+  char * working_set_orig;	/**< @brief Size --records to FACTOR times the memory of the servers (their limit_maxbytes over the mean slab chunk of an item), so FACTOR > 1 keeps them evicting.  Implies --timeline. original value given at command line.  */
+  const char *working_set_help; /**< @brief Size --records to FACTOR times the memory of the servers (their limit_maxbytes over the mean slab chunk of an item), so FACTOR > 1 keeps them evicting.  Implies --timeline. help description.  */
+  const char *timeline_help; /**< @brief Report the hit ratio and the servers' curr_items, memory use, evictions and reclaims every --interval, the latter from a stats side connection to every server. help description.  */
+  const char *server_stats_help; /**< @brief Add the servers' stats, stats slabs and stats items to the --timeline: server QPS and its agreement with this client's (not with --agent), cmd_get rate, conn_yields and CPU per row, and a per slab class summary of the run.  Implies --timeline. help description.  */
+  float stats_interval_arg;	/**< @brief Length of a --timeline row, the period the servers are polled at; rounded to a whole number of --intervals, 0 = one --interval. (default='0').  */
+  char * stats_interval_orig;	/**< @brief Length of a --timeline row, the period the servers are polled at; rounded to a whole number of --intervals, 0 = one --interval. original value given at command line.  */
+  const char *stats_interval_help; /**< @brief Length of a --timeline row, the period the servers are polled at; rounded to a whole number of --intervals, 0 = one --interval. help description.  */
   const char *agentmode_help; /**< @brief Run client in agent mode. help description.  */
   char ** agent_arg;	/**< @brief Enlist remote agent..  */
   char ** agent_orig;	/**< @brief Enlist remote agent. original value given at command line.  */
@@ -199,6 +274,35 @@ struct gengetopt_args_info
   unsigned int keycache_reuse_given ;	/**< @brief Whether keycache_reuse was given.  */
   unsigned int keycache_regen_given ;	/**< @brief Whether keycache_regen was given.  */
   unsigned int plot_all_given ;	/**< @brief Whether plot_all was given.  */
+  unsigned int slo_given ;	/**< @brief Whether slo was given.  */
+  unsigned int slo_gains_given ;	/**< @brief Whether slo_gains was given.  */
+  unsigned int interval_given ;	/**< @brief Whether interval was given.  */
+  unsigned int auto_warmup_given ;	/**< @brief Whether auto_warmup was given.  */
+  unsigned int ci_given ;	/**< @brief Whether ci was given.  */
+  unsigned int ci_nth_given ;	/**< @brief Whether ci_nth was given.  */
+  unsigned int dataset_given ;	/**< @brief Whether dataset was given.  */
+  unsigned int replay_given ;	/**< @brief Whether replay was given.  */
+  unsigned int speedup_given ;	/**< @brief Whether speedup was given.  */
+  unsigned int record_given ;	/**< @brief Whether record was given.  */
+  unsigned int cdf_table_given ;	/**< @brief Whether cdf_table was given.  */
+  unsigned int cdf_table_error_given ;	/**< @brief Whether cdf_table_error was given.  */
+  unsigned int cdf_table_nearest_given ;	/**< @brief Whether cdf_table_nearest was given.  */
+  unsigned int seed_given ;	/**< @brief Whether seed was given.  */
+  unsigned int key_drift_given ;	/**< @brief Whether key_drift was given.  */
+  unsigned int flash_crowd_given ;	/**< @brief Whether flash_crowd was given.  */
+  unsigned int ketama_given ;	/**< @brief Whether ketama was given.  */
+  unsigned int fanout_given ;	/**< @brief Whether fanout was given.  */
+  unsigned int breakdown_given ;	/**< @brief Whether breakdown was given.  */
+  unsigned int outlier_given ;	/**< @brief Whether outlier was given.  */
+  unsigned int size_buckets_given ;	/**< @brief Whether size_buckets was given.  */
+  unsigned int ops_given ;	/**< @brief Whether ops was given.  */
+  unsigned int rmw_retries_given ;	/**< @brief Whether rmw_retries was given.  */
+  unsigned int fill_given ;	/**< @brief Whether fill was given.  */
+  unsigned int ttl_given ;	/**< @brief Whether ttl was given.  */
+  unsigned int working_set_given ;	/**< @brief Whether working_set was given.  */
+  unsigned int timeline_given ;	/**< @brief Whether timeline was given.  */
+  unsigned int server_stats_given ;	/**< @brief Whether server_stats was given.  */
+  unsigned int stats_interval_given ;	/**< @brief Whether stats_interval was given.  */
   unsigned int agentmode_given ;	/**< @brief Whether agentmode was given.  */
   unsigned int agent_given ;	/**< @brief Whether agent was given.  */
   unsigned int agent_port_given ;	/**< @brief Whether agent_port was given.  */
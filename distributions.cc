@@ -4,6 +4,7 @@
 
 #include "distributions.h"
 #include "log.h"
+#include "util.h"
 
 const char* distributions[] =
   { "uniform", "exponential", "zipfian", "latest", NULL };
@@ -16,15 +17,15 @@ distribution_t get_distribution(const char *name) {
 }
 
 double generate_normal(double mean, double sd) {
-  double U = drand48();
-  double V = drand48();
+  double U = rng_double();
+  double V = rng_double();
   double N = sqrt(-2 * log(U)) * cos(2 * M_PI * V);
   return mean + sd * N;
 }
 
 double generate_poisson(double lambda) {
   if (lambda <= 0.0) return 0;
-  double U = drand48();
+  double U = rng_double();
   return -log(U)/lambda;
 }
 
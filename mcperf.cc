@@ -9,6 +9,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <map>
 #include <queue>
 #include <string>
 #include <vector>
@@ -34,8 +35,15 @@
 #include "cmdline.h"
 #include "Connection.h"
 #include "ConnectionOptions.h"
+#include "Dataset.h"
 #include "log.h"
 #include "mcperf.h"
+#include "OpMix.h"
+#include "Recorder.h"
+#include "RunLength.h"
+#include "Trace.h"
+#include "SLOController.h"
+#include "ServerStats.h"
 #include "util.h"
 #include "cpu_stat_thread.h"
 
@@ -45,6 +53,10 @@ using namespace std;
 
 gengetopt_args_info args;
 char random_char[2 * 1024 * 1024];  // Buffer used to generate random values.
+Dataset *dataset = NULL;
+KeyPool *key_pool = NULL;
+uint64_t latest_head = 0;
+Trace *trace = NULL;  // --replay
 
 #ifdef HAVE_LIBZMQ
 vector<zmq::socket_t*> agent_sockets;
@@ -55,6 +67,7 @@ struct thread_data {
   const vector<string> *servers;
   options_t *options;
   bool master;  // Thread #0, not to be confused with agent master.
+  int id;
 #ifdef HAVE_LIBZMQ
   zmq::socket_t *socket;
 #endif
@@ -66,6 +79,27 @@ pthread_barrier_t barrier;
 
 double boot_time;
 
+SLOController *slo = NULL;  // Shared by all threads of a run with --slo.
+map<string, load_cursor_t> load_cursors;   // Loading progress per server.
+WarmupDetector *warmup_detector = NULL;    // --auto_warmup
+RunLengthController *run_length = NULL;    // --ci
+Continuum *continuum = NULL;               // --ketama
+Timeline *timeline = NULL;                 // --timeline, --working_set
+
+#define WORKING_SET_DRAWS 10000  // Item sizes averaged by --working_set.
+
+// The connections of every thread merged by server, and with
+// --breakdown=connection each of them on its own.
+typedef struct {
+  int server, thread, conn;
+  ConnectionStats stats;
+} conn_stats_t;
+
+vector<ConnectionStats> server_stats;
+vector<conn_stats_t> conn_stats;
+vector<string> server_names;
+pthread_mutex_t server_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void init_random_stuff();
 
 void go(const vector<string> &servers, options_t &options,
@@ -82,7 +116,7 @@ char const *command_string[] = {
 };
 
 void do_mcperf(const vector<string> &servers, options_t &options,
-                 ConnectionStats &stats, bool master = true
+                 ConnectionStats &stats, bool master = true, int thread = 0
 #ifdef HAVE_LIBZMQ
 , zmq::socket_t* socket = NULL
 #endif
@@ -344,15 +378,61 @@ V("Done run.");
     as.gets = stats.gets;
     as.sets = stats.sets;
     as.get_misses = stats.get_misses;
+    as.single_misses = stats.single_misses;
+    as.others = stats.others;
+    memcpy(as.type_ops, stats.type_ops, sizeof(as.type_ops));
+    memcpy(as.type_misses, stats.type_misses, sizeof(as.type_misses));
+    as.rmw_attempts = stats.rmw_attempts;
+    as.rmw_conflicts = stats.rmw_conflicts;
+    as.rmw_aborts = stats.rmw_aborts;
+    memcpy(as.rmw_retries, stats.rmw_retries, sizeof(as.rmw_retries));
     as.start = stats.start;
     as.stop = stats.stop;
     as.skips = stats.skips;
+    as.fanouts = stats.fanouts;
+    as.fanout_parts = stats.fanout_parts;
 #ifdef LOGSAMPLER_BINS
 	for (int i=0; i<LOGSAMPLER_BINS; i++) 
 		as.get_bins[i]=stats.get_sampler.bins[i];
 	as.get_sum = stats.get_sampler.sum;
 	as.get_sum_sq = stats.get_sampler.sum_sq;
+	for (int p=0; p<POP_PHASES; p++) {
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			as.phase_bins[p][i]=stats.phase_sampler[p].bins[i];
+		as.phase_sum[p] = stats.phase_sampler[p].sum;
+		as.phase_sum_sq[p] = stats.phase_sampler[p].sum_sq;
+	}
+	for (int i=0; i<LOGSAMPLER_BINS; i++) {
+		as.shard_bins[i]=stats.shard_sampler.bins[i];
+		as.fanout_bins[i]=stats.fanout_sampler.bins[i];
+	}
+	as.shard_sum = stats.shard_sampler.sum;
+	as.shard_sum_sq = stats.shard_sampler.sum_sq;
+	as.fanout_sum = stats.fanout_sampler.sum;
+	as.fanout_sum_sq = stats.fanout_sampler.sum_sq;
+	for (int t=0; t<OP_TYPES; t++) {
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			as.type_bins[t][i]=stats.type_sampler[t].bins[i];
+		as.type_sum[t] = stats.type_sampler[t].sum;
+		as.type_sum_sq[t] = stats.type_sampler[t].sum_sq;
+	}
+	memset(as.size_ops, 0, sizeof(as.size_ops));
+	for (size_t b=0; b<stats.size_sampler.size(); b++) {
+		for (int i=0; i<LOGSAMPLER_BINS; i++)
+			as.size_bins[b][i]=stats.size_sampler[b].bins[i];
+		as.size_sum[b] = stats.size_sampler[b].sum;
+		as.size_sum_sq[b] = stats.size_sampler[b].sum_sq;
+		as.size_ops[b] = stats.size_ops[b];
+		as.size_bytes[b] = stats.size_bytes[b];
+	}
 #endif	
+    as.slo_qps = stats.slo_qps;
+    as.slo_qps_ci = stats.slo_qps_ci;
+    as.slo_intervals = stats.slo_intervals;
+    as.loads = stats.loads;
+    as.load_bytes = stats.load_bytes;
+    as.load_errors = stats.load_errors;
+    as.load_time = stats.load_time;
 
     string req = s_recv(socket);
     V("req = %s", req.c_str());
@@ -389,6 +469,8 @@ void prep_agent(const vector<string>& servers, options_t& options) {
 	aid++;
 
 V("Agent %d prep ", aid);
+    options.load_instance = aid;
+    options.load_instances = agent_sockets.size() + 1;
     memcpy((void *) message.data(), &options, sizeof(options_t));
     status=poll_send(*s,message);
 D("Agent %d prep send = %s", aid, status?"true":"false");
@@ -429,6 +511,9 @@ D("Agent %d prep recv= %s", aid, status?"true":"false");
   }
 
   
+  options.load_instance = 0;
+  options.load_instances = agent_sockets.size() + 1;
+
   // Adjust options_t according to --measure_* arguments.
   options.lambda_denom = sum;
   options.lambda = (double) options.qps / options.lambda_denom *
@@ -647,6 +732,157 @@ string name_to_ipaddr(string host, int addport=1) {
 	return string(ipaddr);
 }
 
+// The latency columns come from the same ops as the count.
+static double p99_of(ConnectionStats &s) {
+  return s.gets + s.sets + s.others ? s.all_ops().get_nth(99) : 0.0;
+}
+
+// Median p99 of the rows that saw any ops.
+static double median_p99(vector<double> p99) {
+  p99.erase(remove(p99.begin(), p99.end(), 0.0), p99.end());
+  if (p99.empty()) return 0.0;
+  sort(p99.begin(), p99.end());
+  return p99[p99.size() / 2];
+}
+
+static void print_breakdown_row(const char *name, const char *ring,
+                                ConnectionStats &s, uint64_t total,
+                                double elapsed, double median) {
+  uint64_t n = s.gets + s.sets + s.others;
+  auto all = s.all_ops();
+  double p99 = p99_of(s);
+
+  printf("%-24s %6s %6.1f%% %10.1f %7.1f %7.1f %7.1f %7.1f", name, ring,
+         total ? (double) n / total * 100 : 0.0, n / elapsed,
+         n ? all.average() : 0.0, n ? all.get_nth(50) : 0.0, p99,
+         n ? all.get_nth(999) : 0.0);
+  if (median > 0.0 && p99 > args.outlier_arg * median)
+    printf("  SLOW p99 %.1fx median", p99 / median);
+  printf("\n");
+}
+
+// --breakdown, --ketama: a row per server (and per connection) of this
+// client, flagging those whose p99 is an outlier against the median row.
+void print_breakdown(ConnectionStats &stats, options_t &options) {
+  double elapsed = stats.stop - stats.start;
+  uint64_t total = 0;
+  vector<double> p99;
+  char name[300], ring[16];
+
+  for (size_t s = 0; s < server_stats.size(); s++) {
+    total += server_stats[s].gets + server_stats[s].sets +
+      server_stats[s].others;
+    p99.push_back(p99_of(server_stats[s]));
+  }
+  double median = median_p99(p99);
+
+  printf("\nPer server (this client):\n");
+  printf("%-24s %6s %7s %10s %7s %7s %7s %7s\n", "#server", "ring", "ops",
+         "QPS", "avg", "p50", "p99", "p999");
+  for (size_t s = 0; s < server_stats.size(); s++) {
+    if (continuum) snprintf(ring, sizeof(ring), "%.1f%%",
+                            continuum->share(s) * 100);
+    else strcpy(ring, "-");
+    print_breakdown_row(server_names[s].c_str(), ring, server_stats[s],
+                        total, elapsed, median);
+  }
+
+  if (!options.breakdown_conns) return;
+
+  p99.clear();
+  for (size_t c = 0; c < conn_stats.size(); c++)
+    p99.push_back(p99_of(conn_stats[c].stats));
+  median = median_p99(p99);
+
+  printf("\nPer connection (thread.connection):\n");
+  for (size_t c = 0; c < conn_stats.size(); c++) {
+    conn_stats_t &cs = conn_stats[c];
+    snprintf(name, sizeof(name), "%s %d.%d",
+             server_names[cs.server].c_str(), cs.thread, cs.conn);
+    print_breakdown_row(name, "-", cs.stats, total, elapsed, median);
+  }
+}
+
+// --ops rmw: how the updates ended, the cas conflict rate and the
+// retries the stored updates took (their latency is the "rmw" row).
+void print_rmw(ConnectionStats &stats, options_t &options) {
+  uint64_t n = stats.type_ops[Operation::RMW], stored = 0;
+  for (int r = 0; r < RMW_RETRY_BINS; r++) stored += stats.rmw_retries[r];
+
+  printf("\nRead-modify-write updates = %" PRIu64
+         " (%.1f%% stored, %.1f%% gave up, %.1f%% missing)\n", n,
+         (double) stored / n * 100, (double) stats.rmw_aborts / n * 100,
+         (double) stats.type_misses[Operation::RMW] / n * 100);
+  printf("cas conflicts = %" PRIu64 " of %" PRIu64 " (%.1f%%)\n",
+         stats.rmw_conflicts, stats.rmw_attempts, stats.rmw_attempts ?
+         (double) stats.rmw_conflicts / stats.rmw_attempts * 100 : 0.0);
+  printf("Retries (of %d):", options.rmw_retries);
+  for (int r = 0; r < RMW_RETRY_BINS; r++)
+    if (stats.rmw_retries[r])
+      printf(" %d%s:%.1f%%", r, r == RMW_RETRY_BINS - 1 ? "+" : "",
+             (double) stats.rmw_retries[r] / stored * 100);
+  printf("\n");
+}
+
+// --size_buckets: a row per value size bucket that saw any ops.
+void print_size_buckets(ConnectionStats &stats, options_t &options) {
+  double elapsed = stats.stop - stats.start;
+  char label[32];
+
+  printf("\nBy value size (%s):\n", args.size_buckets_arg);
+  printf("%-14s %10s %10s %8s %7s %7s %7s %7s\n", "#bytes", "ops", "QPS",
+         "MB/s", "avg", "p50", "p99", "p999");
+  for (size_t b = 0; b < stats.size_ops.size(); b++) {
+    if (stats.size_ops[b] == 0) continue;
+    SizeBuckets::label(options.size_buckets, b, label, sizeof(label));
+    printf("%-14s %10" PRIu64 " %10.1f %8.1f %7.1f %7.1f %7.1f %7.1f\n", label,
+           stats.size_ops[b], stats.size_ops[b] / elapsed,
+           stats.size_bytes[b] / 1024.0 / 1024.0 / elapsed,
+           stats.size_sampler[b].average(), stats.size_sampler[b].get_nth(50),
+           stats.size_sampler[b].get_nth(99),
+           stats.size_sampler[b].get_nth(999));
+  }
+}
+
+// --working_set: as many records as fill FACTOR times the memory of the
+// servers, each item costed at the slab chunk it lands in, averaged over
+// draws of --keysize and --valuesize.  Without --ketama every server
+// stores every record, so the smallest one sets the count.
+void size_working_set(const vector<string> &servers, options_t &options) {
+  double memory = 0.0;
+  for (size_t s = 0; s < servers.size(); s++) {
+    StatsProbe probe(servers[s]);
+    stats_map_t st;
+    if (!probe.query("stats", st))
+      DIE("--working_set: no stats from %s", servers[s].c_str());
+    double m = StatsProbe::get(st, "limit_maxbytes");
+    if (m <= 0.0) DIE("--working_set: no limit_maxbytes from %s",
+                      servers[s].c_str());
+    if (options.ketama) memory += m;
+    else if (memory == 0.0 || m < memory) memory = m;
+  }
+
+  rng_t rng;
+  rng_seed(&rng, options.seed, 0xfffe);
+  rng_current = &rng;
+  Generator *keysize = createGenerator(options.keysize);
+  Generator *valuesize = createGenerator(options.valuesize);
+  KeyGenerator keys(keysize, options.records);
+  double chunk = 0.0;
+  for (int i = 0; i < WORKING_SET_DRAWS; i++)
+    chunk += SizeBuckets::chunk((int) valuesize->generate(),
+                                keys.key_length(rng_next() % options.records));
+  chunk /= WORKING_SET_DRAWS;
+  rng_current = NULL;
+  delete keysize;
+  delete valuesize;
+
+  options.records = (uint64_t) (args.working_set_arg * memory / chunk);
+  if (!options.records) options.records = 1;
+  I("--working_set: %" PRIu64 " records of %.0f bytes for %.1f MB of "
+    "server memory", options.records, chunk, memory / 1024 / 1024);
+}
+
 int main(int argc, char **argv) {
   if (cmdline_parser(argc, argv, &args) != 0) exit(-1);
 
@@ -664,6 +900,45 @@ int main(int argc, char **argv) {
     DIE("--connections must be between [1,%d]", MAXIMUM_CONNECTIONS);
   if (!args.server_given && !args.agentmode_given)
     DIE("--server or --agentmode must be specified.");
+  if (args.slo_given && (args.search_given || args.scan_given))
+    DIE("--slo cannot be combined with --search or --scan");
+  if (args.interval_arg <= 0.0) DIE("--interval must be > 0");
+  if (args.ci_given && args.agent_given)
+    DIE("--ci cannot be combined with --agent");
+  if (args.replay_given &&
+      (args.agent_given || args.roundrobin_given || args.warmup_given))
+    DIE("--replay cannot be combined with --agent, --roundrobin or --warmup");
+  if (args.speedup_arg <= 0.0) DIE("--speedup must be > 0");
+  if (args.record_given &&
+      (args.agent_given || args.replay_given || args.getq_freq_given))
+    DIE("--record cannot be combined with --agent, --replay or --getq_freq");
+  if (args.ketama_given && (args.roundrobin_given || args.replay_given))
+    DIE("--ketama cannot be combined with --roundrobin or --replay");
+  if (args.fanout_given && !args.ketama_given)
+    DIE("--fanout requires --ketama");
+  if (args.breakdown_given && strcmp(args.breakdown_arg, "server") &&
+      strcmp(args.breakdown_arg, "connection"))
+    DIE("--breakdown must be server or connection");
+  if (args.outlier_arg <= 0.0) DIE("--outlier must be > 0");
+  if (args.size_buckets_given && strcmp(args.size_buckets_arg, "log2") &&
+      strcmp(args.size_buckets_arg, "slab"))
+    DIE("--size_buckets must be log2 or slab");
+  if (args.ops_given &&
+      (args.update_given || args.record_given || args.replay_given ||
+       strcasestr(args.keyorder_arg, "latest")))
+    DIE("--ops cannot be combined with --update, --record, --replay or "
+        "--keyorder=latest");
+  if (args.rmw_retries_arg < 0) DIE("--rmw_retries must be >= 0");
+  if ((args.timeline_given || args.working_set_given ||
+       args.server_stats_given) && (args.search_given || args.scan_given))
+    DIE("--timeline, --working_set and --server_stats cannot be combined "
+        "with --search or --scan");
+  if (args.stats_interval_arg < 0.0) DIE("--stats_interval must be >= 0");
+  if (args.working_set_given &&
+      (args.working_set_arg <= 0.0 || args.dataset_given))
+    DIE("--working_set must be > 0 and cannot be combined with --dataset");
+  if (args.cdf_table_arg < 0) DIE("--cdf_table must be >= 0");
+  if (args.cdf_table_error_arg <= 0.0) DIE("--cdf_table_error must be > 0");
 
   // TODO: Discover peers, share arguments.
 
@@ -757,6 +1032,8 @@ int main(int argc, char **argv) {
 	  }
   }
 
+  if (args.working_set_given) size_working_set(servers, options);
+
   ConnectionStats stats;
   if (args.plot_all_given)
 	stats.plotall=true;
@@ -878,9 +1155,24 @@ int main(int argc, char **argv) {
     stats.print_header();
     stats.print_stats("read",   stats.get_sampler, true, true);
     stats.print_stats("update", stats.set_sampler);
+    for (int t = Operation::DELETE; t < OP_TYPES; t++)
+      if (stats.type_ops[t])
+        stats.print_stats(Operation::type_name(t), stats.type_sampler[t]);
     stats.print_stats("op_q",   stats.op_sampler);
 
-    float total = (float)(stats.gets + stats.sets);
+    if (args.flash_crowd_given) {
+      printf("\nRead latency by --flash_crowd phase:\n");
+      for (int p = 0; p < POP_PHASES; p++)
+        stats.print_stats(Popularity::phase_name(p), stats.phase_sampler[p]);
+    }
+
+    if (args.ci_given) {
+      printf("\n95%% CI half-width:\n");
+      stats.print_ci("read",   stats.get_sampler);
+      stats.print_ci("update", stats.set_sampler);
+    }
+
+    float total = (float)(stats.gets + stats.sets + stats.others);
 
     printf("\nTotal QPS = %.1f (%.0f / %.1fs)\n",
            total / (stats.stop - stats.start),
@@ -889,12 +1181,54 @@ int main(int argc, char **argv) {
     if (args.search_given && peak_qps > 0.0)
       printf("Peak QPS  = %.1f\n", peak_qps);
 
+    if (args.auto_warmup_given)
+      printf("Warmup    = %.1fs (%s)\n", stats.warmup_time,
+             stats.warmup_time < options.warmup ? "steady state" :
+             "capped by --warmup");
+    if (args.ci_given)
+      printf("p%g CI    = +/- %.1f%% (%s)\n", options.ci_nth,
+             stats.ci_precision * 100,
+             stats.ci_converged ? "converged" : "capped by --time");
+
+    if (args.slo_given)
+      printf("SLO QPS   = %.1f +/- %.1f (95%% CI over %d intervals, p%g <= %.0fus)\n",
+             stats.slo_qps, stats.slo_qps_ci, stats.slo_intervals,
+             options.slo_nth, options.slo_target);
+
+    if (args.fanout_given && stats.fanouts > 0) {
+      printf("\nFan-out multi-gets = %" PRIu64 " (%.2f parts avg):\n",
+             stats.fanouts, (double) stats.fanout_parts / stats.fanouts);
+      stats.print_stats("part", stats.shard_sampler);
+      stats.print_stats("fanout", stats.fanout_sampler);
+      if (stats.shard_sampler.total() > 0 && stats.fanout_sampler.total() > 0)
+        printf("p99 amplification = %.2fx\n",
+               stats.fanout_sampler.get_nth(99) /
+               stats.shard_sampler.get_nth(99));
+    }
+
+    if (stats.type_ops[Operation::RMW] > 0) print_rmw(stats, options);
+
+    if (args.ketama_given || args.breakdown_given)
+      print_breakdown(stats, options);
+    if (args.size_buckets_given) print_size_buckets(stats, options);
+    if (timeline) timeline->print();
+
     printf("\n");
 	
 	printf("Total connections = %d\n", options.connections * options.server_given * options.threads);
 
     printf("Misses = %" PRIu64 " (%.1f%%)\n", stats.get_misses,
            (double) stats.get_misses/stats.gets*100);
+    for (int t = Operation::DELETE; t < OP_TYPES; t++)
+      if (stats.type_ops[t])
+        printf("  %-7s %" PRIu64 " (%.1f%%)\n", Operation::type_name(t),
+               stats.type_misses[t],
+               (double) stats.type_misses[t] / stats.type_ops[t] * 100);
+    if (args.fill_given)
+      printf("Fills = %" PRIu64 " (%.1f%% of single-key get misses)\n",
+             stats.type_ops[Operation::FILL],
+             stats.single_misses ? (double) stats.type_ops[Operation::FILL] /
+             stats.single_misses * 100 : 0.0);
 
     printf("Skipped TXs = %" PRIu64 " (%.1f%%)\n\n", stats.skips,
            (double) stats.skips / total * 100);
@@ -919,6 +1253,23 @@ int main(int argc, char **argv) {
     }
   }
 
+  uint64_t regens = 0;
+  double regen_time, regen_max;
+  if (key_pool) key_pool->regen_stats(regens, regen_time, regen_max);
+  if (!args.scan_given && regens > 0)
+    printf("Key pool regenerated %" PRIu64 " times in the background : "
+           "%.2f ms avg, %.2f ms max\n", regens, regen_time / regens * 1000,
+           regen_max * 1000);
+
+  if (!args.scan_given && stats.loads > 0) {
+    printf("Loaded %" PRIu64 " records in %.1fs : %.1f sets/s, %.1f MB/s",
+           stats.loads, stats.load_time, stats.loads / stats.load_time,
+           (double) stats.load_bytes / 1024 / 1024 / stats.load_time);
+    if (stats.load_errors)
+      printf(" (%" PRIu64 " failed)", stats.load_errors);
+    printf("\n");
+  }
+
   stop_cpu_stats();
   pthread_join(cpustat.tid,0);
   if (!args.loadonly_given)
@@ -945,6 +1296,17 @@ int main(int argc, char **argv) {
   return 0;
 }
 
+// The options key_pool was drawn with.
+static options_t key_pool_options;
+
+static bool same_key_pool(const options_t &a, const options_t &b) {
+  return !strcmp(a.keysize, b.keysize) && !strcmp(a.keyorder, b.keyorder) &&
+    a.records == b.records && a.seed == b.seed &&
+    a.load_instance == b.load_instance && a.cdf_table == b.cdf_table &&
+    a.cdf_table_error == b.cdf_table_error &&
+    a.cdf_table_nearest == b.cdf_table_nearest;
+}
+
 void go(const vector<string>& servers, options_t& options,
         ConnectionStats &stats
 #ifdef HAVE_LIBZMQ
@@ -959,6 +1321,75 @@ V("Agent prep done.");
   }
 #endif
 
+  // Agents map the dataset when the master first asks for it.
+  if (options.dataset[0] && dataset == NULL)
+    dataset = new Dataset(options.dataset);
+
+  // Agents get the servers of every run, so the continuum is too.
+  delete continuum;
+  continuum = options.ketama ? new Continuum(servers) : NULL;
+
+  server_names = servers;
+  server_stats.assign(servers.size(), ConnectionStats());
+  conn_stats.clear();
+
+  // One key pool for every connection of this process, drawn from its
+  // own stream so it does not depend on the number of threads.  Agents
+  // get the options of every run, so it is redrawn when they change.
+  if (key_pool && !same_key_pool(key_pool_options, options)) {
+    delete key_pool;
+    key_pool = NULL;
+  }
+  if (key_pool == NULL && args.keycache_capacity_arg > 0) {
+    key_pool_options = options;
+    rng_seed(options.seed, ((uint64_t) options.load_instance << 16) | 0xffff);
+    key_pool = new KeyPool(createTabulated(createGenerator(options.keysize),
+                                           options.cdf_table,
+                                           options.cdf_table_error,
+                                           options.cdf_table_nearest),
+                           createGenerator(options.keyorder), options.records,
+                           args.keycache_capacity_arg, dataset,
+                           args.keycache_regen_arg);
+  }
+
+  // This instance's share of the records, loaded into every server by
+  // all of the connections to it.
+  load_cursors.clear();
+  for (vector<string>::const_iterator s = servers.begin();
+       s != servers.end(); s++) {
+    load_cursor_t &c = load_cursors[*s];
+    c.next = (int64_t) options.records * options.load_instance /
+      options.load_instances;
+    c.last = (int64_t) options.records * (options.load_instance + 1) /
+      options.load_instances;
+  }
+
+  if (options.slo_target > 0.0 && options.threads > 0) {
+    // The connections of this instance, as counted in lambda_denom.
+    int local = options.connections * (options.roundrobin ?
+      max((int) servers.size(), options.threads) :
+      (int) servers.size() * options.threads);
+    double share = options.lambda_denom > 0 ?
+      (double) local * args.lambda_mul_arg / options.lambda_denom : 1.0;
+    slo = new SLOController(options.threads, options.interval,
+                            options.slo_nth, options.slo_target,
+                            options.slo_kp, options.slo_ki, options.qps,
+                            share < 1.0 ? share : 1.0);
+  }
+  if (options.auto_warmup && options.threads > 0)
+    warmup_detector = new WarmupDetector(options.threads, options.interval,
+                                         options.ci_nth);
+  if (options.ci > 0.0 && options.threads > 0)
+    run_length = new RunLengthController(options.threads, options.interval,
+                                         options.ci_nth, options.ci);
+  if (options.timeline && options.threads > 0 && !args.agentmode_given) {
+    delete timeline;
+    int every = (int) (args.stats_interval_arg / options.interval + 0.5);
+    timeline = new Timeline(options.threads, options.interval, servers,
+                            every > 1 ? every : 1, args.server_stats_given,
+                            args.agent_given > 0);
+  }
+
   if (options.threads > 1) {
     pthread_t pt[options.threads];
     struct thread_data td[options.threads];
@@ -980,6 +1411,7 @@ D("Starting %d threads.", options.threads);
 #endif
       if (t == 0) td[t].master = true;
       else td[t].master = false;
+      td[t].id = t;
 
       if (options.roundrobin) {
         for (unsigned int i = (t % servers.size());
@@ -1029,7 +1461,7 @@ D("Waiting for thread %d.",t);
       delete cs;
     }
   } else if (options.threads == 1) {
-    do_mcperf(servers, options, stats, true
+    do_mcperf(servers, options, stats, true, 0
 #ifdef HAVE_LIBZMQ
 , socket
 #endif
@@ -1043,9 +1475,42 @@ D("Waiting for thread %d.",t);
 #endif
   }
 
+  if (slo) {
+    stats.slo_qps = slo->steady_state_qps(&stats.slo_qps_ci,
+                                          &stats.slo_intervals);
+    delete slo;
+    slo = NULL;
+  }
+  if (options.record[0]) {
+    // Every run (of --scan, --search, ...) gets a trace of its own:
+    // FILE, then FILE.1, FILE.2 and so on.
+    static int record_run = 0;
+    char path[sizeof(options.record) + 16];
+    if (record_run) snprintf(path, sizeof(path), "%s.%d", options.record,
+                             record_run);
+    else strcpy(path, options.record);
+    Recorder::merge(options.record, path, options.threads);
+    record_run++;
+  }
+
+  if (warmup_detector) {
+    stats.warmup_time = warmup_detector->warm() ?
+      warmup_detector->warmup_time() : options.warmup;
+    delete warmup_detector;
+    warmup_detector = NULL;
+  }
+  if (run_length) {
+    stats.ci_converged = run_length->converged();
+    stats.ci_precision = run_length->precision();
+    delete run_length;
+    run_length = NULL;
+  }
+  if (timeline) timeline->finish();  // Summed up with the rest of the report.
+
 #ifdef HAVE_LIBZMQ
 	if (args.agent_given || args.agentmode_given) {
-    	float total = (float)(stats.gets) + (float)stats.sets;
+    	float total = (float)(stats.gets) + (float)stats.sets +
+    	  (float)stats.others;
 
 	    V("Local QPS = %.1f (%lld / %.1fs)",
     	total / (stats.stop - stats.start),
@@ -1063,7 +1528,7 @@ void* thread_main(void *arg) {
 
   ConnectionStats *cs = new ConnectionStats();
 
-  do_mcperf(*td->servers, *td->options, *cs, td->master
+  do_mcperf(*td->servers, *td->options, *cs, td->master, td->id
 #ifdef HAVE_LIBZMQ
 , td->socket
 #endif
@@ -1072,8 +1537,23 @@ void* thread_main(void *arg) {
   return cs;
 }
 
+// Per-thread interval bookkeeping: the totals of a thread's
+// connections accumulated since the previous call.
+static IntervalSample interval_delta(vector<Connection*> &connections,
+                                     IntervalSample &last) {
+  IntervalSample cur;
+  for (vector<Connection*>::iterator i = connections.begin();
+       i != connections.end(); i++)
+    cur.add((*i)->stats);
+
+  IntervalSample delta = cur;
+  delta.subtract(last);
+  last = cur;
+  return delta;
+}
+
 void do_mcperf(const vector<string>& servers, options_t& options,
-                 ConnectionStats& stats, bool master
+                 ConnectionStats& stats, bool master, int thread
 #ifdef HAVE_LIBZMQ
 , zmq::socket_t* socket
 #endif
@@ -1083,6 +1563,9 @@ void do_mcperf(const vector<string>& servers, options_t& options,
 
   char *saveptr = NULL;  // For reentrant strtok().
 
+  // Before any generator runs: the key caches are filled below.
+  rng_seed(options.seed, ((uint64_t) options.load_instance << 16) | thread);
+
   struct event_base *base;
   struct evdns_base *evdns;
   struct event_config *config;
@@ -1108,9 +1591,15 @@ void do_mcperf(const vector<string>& servers, options_t& options,
   double now = start;
 
   vector<Connection*> connections;
-  vector<Connection*> server_lead;
+  vector<load_cursor_t*> cursors;  // The server of each connection.
 	 vector<string>::const_iterator s;
 
+  router_t router;
+  router.continuum = continuum;
+  router.servers.resize(servers.size());
+  router.next.resize(servers.size(), 0);
+  router.loads.resize(servers.size());
+
   for (s=servers.begin(); s!=servers.end(); s++) {
     // Split args.server_arg[s] into host:port using strtok().
     char *s_copy = new char[s->length() + 1];
@@ -1135,12 +1624,20 @@ void do_mcperf(const vector<string>& servers, options_t& options,
 
       Connection* conn = new Connection(base, evdns, hostname, port, options,
                                         args.agentmode_given ? true :
-                                        true,
-										args.keycache_capacity_given ? args.keycache_capacity_arg : 0,
-										args.keycache_reuse_given ? args.keycache_reuse_arg : 0,
-										args.keycache_regen_given ? args.keycache_regen_arg : 0);
+                                        true, args.keycache_reuse_arg);
       connections.push_back(conn);
-      if (c == 0) server_lead.push_back(conn);
+      // With --ketama the servers share one cursor over all records,
+      // and each record goes to its owner.
+      cursors.push_back(&load_cursors.find(options.ketama ? servers[0] : *s)
+                        ->second);
+
+      // Index into all servers; --roundrobin threads only see some.
+      conn->server_id = find(server_names.begin(), server_names.end(), *s) -
+        server_names.begin();
+      if (options.ketama) {
+        conn->router = &router;
+        router.servers[conn->server_id].push_back(conn);
+      }
     }
   }
 
@@ -1176,20 +1673,17 @@ void do_mcperf(const vector<string>& servers, options_t& options,
   }
   D("evt based loop end\n");
 
-  // Load database on lead connection for each server.
-  // TODO: parallelize the database loading to multiple threads
-  if (!options.noload) {
+  // Load database on all connections of all threads (and agents).
+  // With --noload they still seed the --ops counters, if there are any.
+  if (!options.noload || options.ops[0]) {
     D("Loading database.");
-	vector<Connection*>::iterator c;
-    for (c= server_lead.begin(); c!=server_lead.end(); c++ ) (*c)->start_loading();
+    double load_start = get_time();
+    for (size_t c = 0; c < connections.size(); c++)
+      connections[c]->start_loading(cursors[c]);
 
-    // Wait for all Connections to become IDLE.
+    // Wait for all Connections to become IDLE.  Checked first: with
+    // --ketama another thread may have claimed all of the records.
     while (1) {
-      // FIXME: If all connections become ready before event_base_loop
-      // is called, this will deadlock.
-    event_base_loopexit(base, &delay);
-      event_base_loop(base, EVLOOP_ONCE );
-
       bool restart = false;
          vector<Connection*>::iterator conn;
     for (conn= connections.begin(); conn!=connections.end(); conn++ )
@@ -1198,9 +1692,18 @@ void do_mcperf(const vector<string>& servers, options_t& options,
 
 	}
 
-      if (restart) continue;
-      else break;
+      if (!restart) break;
+
+    event_base_loopexit(base, &delay);
+      event_base_loop(base, EVLOOP_ONCE );
+    }
+
+    for (size_t c = 0; c < connections.size(); c++) {
+      stats.loads += connections[c]->loader_completed;
+      stats.load_bytes += connections[c]->loader_bytes;
+      stats.load_errors += connections[c]->loader_errors;
     }
+    stats.load_time = get_time() - load_start;
   }
 
   if (options.loadonly) {
@@ -1247,6 +1750,10 @@ void do_mcperf(const vector<string>& servers, options_t& options,
       conn->drive_write_machine(); // Kick the Connection into motion.
     }
 
+    IntervalSample last_interval;
+    int interval_id = 0;
+    double next_interval = start + options.interval;
+
     while (1) {
       event_base_loop(base, loop_flag);
 
@@ -1258,6 +1765,17 @@ void do_mcperf(const vector<string>& servers, options_t& options,
       now = tv_to_double(&now_tv);
       //#endif
 
+      if (warmup_detector && now >= next_interval) {
+        warmup_detector->add(interval_id++,
+                             interval_delta(connections, last_interval));
+        next_interval += options.interval;
+
+        // Steady state: cut the warmup short.
+        if (warmup_detector->warm())
+          for (iconn= connections.begin(); iconn!=connections.end(); iconn++ )
+            (*iconn)->options.time = 0;
+      }
+
       bool restart = false;
          vector<Connection*>::iterator iconn;
     for (iconn= connections.begin(); iconn!=connections.end(); iconn++ ) {
@@ -1312,6 +1830,9 @@ void do_mcperf(const vector<string>& servers, options_t& options,
   }
 
 
+  // The other threads wait at the barrier for the server baseline.
+  if (master && timeline) timeline->begin();
+
   // FIXME: Synchronize start_time here across threads/nodes.
   pthread_barrier_wait(&barrier);
 
@@ -1337,6 +1858,15 @@ void do_mcperf(const vector<string>& servers, options_t& options,
   }
 #endif
 
+  Recorder *recorder = NULL;
+  if (options.record[0]) {
+    recorder = new Recorder(options.record, thread);
+    for (size_t c = 0; c < connections.size(); c++) {
+      connections[c]->recorder = recorder;
+      connections[c]->record_id = thread * connections.size() + c;
+    }
+  }
+
   if (master && !args.scan_given && !args.search_given)
     V("started at %f", get_time());
 
@@ -1358,6 +1888,18 @@ void do_mcperf(const vector<string>& servers, options_t& options,
 
   //  V("Start = %f", start);
 
+  TraceReplayer *replayer = NULL;
+  if (trace) {
+    replayer = new TraceReplayer(trace, base, connections, thread,
+                                 options.speedup);
+    replayer->start(start);
+  }
+
+  // Interval bookkeeping for --slo, --ci and --timeline.
+  IntervalSample last_interval;
+  int interval_id = 0;
+  double next_interval = start + options.interval;
+
   // Main event loop.
   while (1) {
     event_base_loop(base, loop_flag);
@@ -1370,6 +1912,45 @@ void do_mcperf(const vector<string>& servers, options_t& options,
     now = tv_to_double(&now_tv);
     //#endif
 
+    if ((slo || run_length || timeline) && now >= next_interval) {
+      IntervalSample delta = interval_delta(connections, last_interval);
+      next_interval += options.interval;
+
+      if (slo) {
+        slo->add(interval_id, delta);
+
+        // Follow the controller; other threads do the same at their own
+        // interval boundary.
+        double lambda = slo->get_target_qps() / options.lambda_denom *
+          args.lambda_mul_arg;
+        for (iconn= connections.begin(); iconn!=connections.end(); iconn++ )
+          (*iconn)->set_lambda(lambda);
+      }
+
+      if (run_length) {
+        run_length->add(interval_id, delta);
+
+        // Precise enough: stop early, same as when --time runs out.
+        if (run_length->converged())
+          for (iconn= connections.begin(); iconn!=connections.end(); iconn++ )
+            (*iconn)->options.time = 0;
+      }
+
+      if (timeline) timeline->add(interval_id, delta);
+
+      interval_id++;
+    }
+
+    // End of the trace: stop once the last responses are in.
+    if (replayer && replayer->done()) {
+      bool drained = true;
+      for (iconn= connections.begin(); iconn!=connections.end(); iconn++ )
+        if ((*iconn)->op_queue.size() > 0) drained = false;
+      if (drained)
+        for (iconn= connections.begin(); iconn!=connections.end(); iconn++ )
+          (*iconn)->options.time = 0;
+    }
+
     bool restart = false;
          vector<Connection*>::iterator iconn;
     for (iconn= connections.begin(); iconn!=connections.end(); iconn++ ) {
@@ -1395,6 +1976,19 @@ void do_mcperf(const vector<string>& servers, options_t& options,
     V("stopped at %f  options.time = %d", get_time(), options.time);
 
   // Tear-down and accumulate stats.
+	pthread_mutex_lock(&server_stats_lock);
+	for (iconn= connections.begin(); iconn!=connections.end(); iconn++ ) {
+		Connection *conn=*iconn;
+		server_stats[conn->server_id].accumulate(conn->stats);
+		if (options.breakdown_conns) {
+			conn_stats_t c = { conn->server_id, thread,
+			                   (int) (iconn - connections.begin()),
+			                   conn->stats };
+			conn_stats.push_back(c);
+		}
+	}
+	pthread_mutex_unlock(&server_stats_lock);
+
 	for (iconn= connections.begin(); iconn!=connections.end(); iconn++ ) {
 		Connection *conn=*iconn;
 		stats.accumulate(conn->stats);
@@ -1404,6 +1998,14 @@ void do_mcperf(const vector<string>& servers, options_t& options,
 	stats.start = start;
 	stats.stop = now;
 
+	if (replayer) {
+		V("Replayed %" PRIu64 " ops (%s), max lag %.1fms", replayer->issued,
+		  replayer->done() ? "complete" : "stopped by --time",
+		  replayer->max_lag * 1000);
+		delete replayer;
+	}
+	delete recorder;  // Flushes the last records.
+
 	event_config_free(config);
 	evdns_base_free(evdns, 0);
 	event_base_free(base);
@@ -1430,8 +2032,7 @@ static mc_profile mc_profiles[] = {
 	{1.,1000000,NULL,"32","none","200",NULL,100000,10000,5,1},
 //4. P99.9, 1 msec. Key size = 32 bytes; value size has uniform distribution from 100 bytes to 1k; 
 //	 key request should arrive with zipfian distribution; metric is QPS.
-//	Instead of zipf, use pareto distribution with scale of 16 and shape of 0.154971, 0 offset.
-	{100.,1000000,"999:1000","32","pareto:0.0,16,0.154971","uniform:100,1000",NULL,0,10000,10,1}
+	{100.,1000000,"999:1000","32","zipf:0.99","uniform:100,1000",NULL,0,10000,10,1}
 };
 #define max_profiles (sizeof(mc_profiles)/sizeof(mc_profile))
 
@@ -1488,6 +2089,8 @@ void args_to_options(options_t* options) {
   options->connections = args.connections_arg;
   options->blocking = args.blocking_given;
   options->qps = args.qps_arg;
+  // The --slo controller needs a rate to start from.
+  if (args.slo_given && options->qps == 0) options->qps = SLO_INITIAL_QPS;
   options->threads = args.threads_arg;
   options->server_given = args.server_given;
   options->roundrobin = args.roundrobin_given;
@@ -1515,7 +2118,17 @@ void args_to_options(options_t* options) {
 
   if (options->server_given==0)
 	options->server_given=1;
-  options->records = args.records_arg / options->server_given;
+  if (args.records_arg < 0) DIE("--records must be positive");
+  if (args.keycache_capacity_arg < 0)
+    DIE("--keycache_capacity must be 0 or more");
+  options->ketama = args.ketama_given;
+  options->fanout = args.fanout_given;
+  options->breakdown_conns = args.breakdown_given &&
+    !strcmp(args.breakdown_arg, "connection");
+  options->size_buckets = !args.size_buckets_given ? SIZE_NONE :
+    !strcmp(args.size_buckets_arg, "slab") ? SIZE_SLAB : SIZE_LOG2;
+  options->records = options->ketama ? args.records_arg :
+    args.records_arg / options->server_given;
 
   options->binary = args.binary_given;
   options->sasl = args.username_given;
@@ -1530,9 +2143,60 @@ void args_to_options(options_t* options) {
   else
     strcpy(options->username, "");
 
-  D("options->records = %d", options->records);
+  D("options->records = %" PRIu64, options->records);
 
   if (!options->records) options->records = 1;
+
+  if (args.dataset_given) {
+    if (strlen(args.dataset_arg) >= sizeof(options->dataset))
+      DIE("--dataset: path too long");
+    strcpy(options->dataset, args.dataset_arg);
+    if (dataset == NULL) dataset = new Dataset(args.dataset_arg);
+    options->records = dataset->size();
+  }
+
+  if (args.replay_given) {
+    if (strlen(args.replay_arg) >= sizeof(options->replay))
+      DIE("--replay: path too long");
+    strcpy(options->replay, args.replay_arg);
+    if (trace == NULL) {
+      trace = new Trace(args.replay_arg);
+      // No --roundrobin: every thread connects to every server.
+      trace->split(vector<int>(options->threads,
+                               options->server_given * options->connections));
+    }
+  }
+  options->speedup = args.speedup_arg;
+
+  if (args.record_given) {
+    if (strlen(args.record_arg) >= sizeof(options->record))
+      DIE("--record: path too long");
+    strcpy(options->record, args.record_arg);
+  }
+  if (args.ops_given) {
+    if (strlen(args.ops_arg) >= sizeof(options->ops))
+      DIE("--ops: mix too long");
+    strcpy(options->ops, args.ops_arg);
+    OpMix check(options->ops);  // DIEs on a bad mix.
+  }
+  options->rmw_retries = args.rmw_retries_arg;
+  if (args.fill_given) {
+    if (strlen(args.fill_arg) >= sizeof(options->fill))
+      DIE("Distribution argument too long");
+    strcpy(options->fill, args.fill_arg);
+  }
+  if (args.ttl_given) {
+    if (strlen(args.ttl_arg) >= sizeof(options->ttl))
+      DIE("Distribution argument too long");
+    strcpy(options->ttl, args.ttl_arg);
+  }
+  options->timeline = args.timeline_given || args.working_set_given ||
+    args.server_stats_given;
+  if (strlen(args.keysize_arg) >= sizeof(options->keysize) ||
+      strlen(args.keyorder_arg) >= sizeof(options->keyorder) ||
+      strlen(args.valuesize_arg) >= sizeof(options->valuesize) ||
+      strlen(args.iadist_arg) >= sizeof(options->ia))
+    DIE("Distribution argument too long");
   strcpy(options->keysize, args.keysize_arg);
   strcpy(options->keyorder, args.keyorder_arg);
   strcpy(options->valuesize, args.valuesize_arg);
@@ -1542,14 +2206,55 @@ void args_to_options(options_t* options) {
   options->depth = args.depth_arg;
   options->no_nodelay = args.no_nodelay_given;
   options->noload = args.noload_given;
+  options->load_instance = 0;
+  options->load_instances = 1;
   options->iadist = get_distribution(args.iadist_arg);
   strcpy(options->ia, args.iadist_arg);
+  options->cdf_table = args.cdf_table_arg;
+  options->cdf_table_error = args.cdf_table_error_arg;
+  options->cdf_table_nearest = args.cdf_table_nearest_given;
+  options->seed = args.seed_arg ? (uint64_t) args.seed_arg :
+    fnv_64((uint64_t) (get_time() * 1e6));
+  if (args.seed_given) V("Seed = %" PRIu64, options->seed);
   options->warmup = args.warmup_given ? args.warmup_arg : 0;
   options->oob_thread = false;
   options->skip = args.skip_given;
   options->moderate = args.moderate_given;
   options->getq_freq = args.getq_freq_given ? args.getq_freq_arg : 0.0;
   options->getq_size = args.getq_size_arg;
+
+  options->interval = args.interval_arg;
+
+  options->auto_warmup = args.auto_warmup_given;
+  if (options->auto_warmup && !args.warmup_given)
+    options->warmup = options->time;
+  options->ci = args.ci_given ? args.ci_arg : 0.0;
+  options->ci_nth = args.ci_nth_arg;
+  if (args.slo_given) {
+    if (sscanf(args.slo_arg, "%lf:%lf", &options->slo_nth,
+               &options->slo_target) != 2 || options->slo_target <= 0.0)
+      DIE("Invalid --slo argument");
+    if (sscanf(args.slo_gains_arg, "%lf,%lf", &options->slo_kp,
+               &options->slo_ki) != 2)
+      DIE("Invalid --slo_gains argument");
+  }
+
+  options->drift_rate = options->drift_period = 0.0;
+  if (args.key_drift_given &&
+      (sscanf(args.key_drift_arg, "%lf:%lf", &options->drift_rate,
+              &options->drift_period) < 1 ||
+       options->drift_rate < 0.0 || options->drift_period < 0.0))
+    DIE("Invalid --key_drift argument");
+
+  options->flash_share = 0.0;
+  options->flash_keys = 10;
+  if (args.flash_crowd_given &&
+      (sscanf(args.flash_crowd_arg, "%lf:%lf:%lf:%" SCNu64,
+              &options->flash_start, &options->flash_share,
+              &options->flash_duration, &options->flash_keys) < 3 ||
+       options->flash_share <= 0.0 || options->flash_share > 1.0 ||
+       options->flash_duration <= 0.0 || options->flash_keys == 0))
+    DIE("Invalid --flash_crowd argument");
 }
 
 void init_random_stuff() {
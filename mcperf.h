@@ -1,6 +1,8 @@
 #ifndef MCPERF_H
 #define MCPERF_H
 
+#include <stdint.h>
+
 #include "cmdline.h"
 
 #define USE_CACHED_TIME 0
@@ -10,8 +12,17 @@
 #define MAX_SAMPLES 100000
 
 #define LOADER_CHUNK 1024
+#define LOADER_WINDOWS 4  // LOADER_CHUNKs in flight per loading connection.
+
+#define SLO_INITIAL_QPS 1000
+
+class Dataset;
+class KeyPool;
 
 extern char random_char[];
+extern Dataset *dataset;  // --dataset, NULL if not given.
+extern KeyPool *key_pool;  // Request keys shared by all connections.
+extern uint64_t latest_head;  // --keyorder=latest inserts, ditto.
 extern gengetopt_args_info args;
 
 #endif // MCPERF_H
@@ -1,5 +1,6 @@
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -10,6 +11,29 @@ void sleep_time(double duration) {
   if (duration > 0) usleep((useconds_t) (duration * 1000000));
 }
 
+__thread rng_t rng_thread = {{
+  0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+  0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+}};
+__thread rng_t *rng_current = NULL;
+
+// Expand seed and stream into a state with splitmix64.
+void rng_seed(rng_t *r, uint64_t seed, uint64_t stream) {
+  uint64_t z = seed ^ (stream * 0x9e3779b97f4a7c15ULL);
+  for (int i = 0; i < 4; i++) {
+    z += 0x9e3779b97f4a7c15ULL;
+    uint64_t x = z;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    r->s[i] = x ^ (x >> 31);
+  }
+}
+
+const char digit_pairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
 #define FNV_64_PRIME (0x100000001b3ULL)
 #define FNV1_64_INIT (0xcbf29ce484222325ULL)
 uint64_t fnv_64_buf(const void* buf, size_t len) {
@@ -26,6 +50,72 @@ uint64_t fnv_64_buf(const void* buf, size_t len) {
   return hval;
 }
 
+static const uint32_t md5_k[64] = {
+  0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a,
+  0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+  0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340,
+  0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+  0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+  0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+  0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+  0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+  0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92,
+  0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+  0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const int md5_r[64] = {
+  7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+  5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+  4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+  6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+static void md5_block(uint32_t h[4], const unsigned char *p) {
+  uint32_t w[16];
+  for (int i = 0; i < 16; i++)
+    w[i] = p[i*4] | (p[i*4+1] << 8) | (p[i*4+2] << 16) |
+      ((uint32_t) p[i*4+3] << 24);
+
+  uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+  for (int i = 0; i < 64; i++) {
+    uint32_t f;
+    int g;
+    if (i < 16)      { f = (b & c) | (~b & d); g = i; }
+    else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) & 15; }
+    else if (i < 48) { f = b ^ c ^ d;          g = (3 * i + 5) & 15; }
+    else             { f = c ^ (b | ~d);       g = (7 * i) & 15; }
+    uint32_t t = d;
+    d = c;
+    c = b;
+    uint32_t x = a + f + md5_k[i] + w[g];
+    b += (x << md5_r[i]) | (x >> (32 - md5_r[i]));
+    a = t;
+  }
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+}
+
+void md5(const void *buf, size_t len, unsigned char digest[16]) {
+  uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+  const unsigned char *p = (const unsigned char *) buf;
+  size_t n = len;
+
+  for (; n >= 64; n -= 64, p += 64) md5_block(h, p);
+
+  // Pad with 0x80, zeros and the bit length, one or two blocks.
+  unsigned char tail[128] = {0};
+  memcpy(tail, p, n);
+  tail[n] = 0x80;
+  size_t t = n < 56 ? 64 : 128;
+  uint64_t bits = (uint64_t) len * 8;
+  for (int i = 0; i < 8; i++) tail[t - 8 + i] = bits >> (8 * i);
+  md5_block(h, tail);
+  if (t == 128) md5_block(h, tail + 64);
+
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++) digest[i*4 + j] = h[i] >> (8 * j);
+}
+
 void generate_key(int n, int length, char *buf) {
   snprintf(buf, length + 1, "%0*d", length, n);
 }
@@ -1,6 +1,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdint.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -47,6 +48,88 @@ void sleep_time(double duration);
 uint64_t fnv_64_buf(const void* buf, size_t len);
 inline uint64_t fnv_64(uint64_t in) { return fnv_64_buf(&in, sizeof(in)); }
 
+// RFC 1321 MD5, as used by ketama to place servers and keys.
+void md5(const void *buf, size_t len, unsigned char digest[16]);
+
 void generate_key(int n, int length, char *buf);
 
+// Decimal formatting without printf, two digits at a time.
+extern const char digit_pairs[201];
+
+inline int u64_digits(uint64_t v) {
+  int n = 1;
+  while (v >= 10000) { v /= 10000; n += 4; }
+  if (v >= 10) n++;
+  if (v >= 100) n++;
+  if (v >= 1000) n++;
+  return n;
+}
+
+// Write v zero-padded to width (at least its own digits) into out,
+// without a NUL.  Returns the length written.
+inline int format_u64(char *out, uint64_t v, int width = 0) {
+  int n = u64_digits(v);
+  int len = width > n ? width : n;
+  char *p = out + len;
+  while (v >= 100) {
+    int i = (v % 100) * 2;
+    v /= 100;
+    *--p = digit_pairs[i + 1];
+    *--p = digit_pairs[i];
+  }
+  if (v >= 10) {
+    *--p = digit_pairs[v * 2 + 1];
+    *--p = digit_pairs[v * 2];
+  } else {
+    *--p = '0' + v;
+  }
+  while (p > out) *--p = '0';
+  return len;
+}
+
+// Pseudo-random numbers: xoshiro256** (Blackman and Vigna).  Every
+// thread has its own state, and a Connection can install its own with
+// rng_current while it runs, so there is no shared drand48 state
+// bouncing between cores and each connection's request stream is
+// reproducible from --seed.  Until rng_seed() the thread uses a fixed
+// default state.
+typedef struct {
+  uint64_t s[4];
+} rng_t;
+
+extern __thread rng_t rng_thread;
+extern __thread rng_t *rng_current;  // NULL = rng_thread.
+
+void rng_seed(rng_t *r, uint64_t seed, uint64_t stream);
+inline void rng_seed(uint64_t seed, uint64_t stream) {
+  rng_current = NULL;
+  rng_seed(&rng_thread, seed, stream);
+}
+
+inline uint64_t rng_next() {
+  uint64_t *s = rng_current ? rng_current->s : rng_thread.s;
+  uint64_t x = s[1] * 5;
+  uint64_t result = ((x << 7) | (x >> 57)) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = (s[3] << 45) | (s[3] >> 19);
+
+  return result;
+}
+
+// Uniform on [0, 1), like drand48().
+inline double rng_double() {
+  return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Fill U[0..n) with uniforms on [0, 1).
+inline void rng_fill(double *U, int n) {
+  for (int i = 0; i < n; i++) U[i] = rng_double();
+}
+
 #endif // UTIL_H